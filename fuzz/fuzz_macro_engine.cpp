@@ -0,0 +1,159 @@
+/**
+ * fuzz_macro_engine.cpp
+ * libFuzzer-Ziel für die Makro-Engine (Laufzeit- und Wachstumsfehler).
+ *
+ * Sucht Eingaben, deren Verarbeitung überproportional Zeit oder Speicher
+ * kostet (quadratisches oder exponentielles Verhalten). Eine Eingabe gilt
+ * als auffällig, wenn
+ *   - die Laufzeit kBaseNanos + kNanosPerByte * Eingabegröße übersteigt, oder
+ *   - die Ausgabe größer als kBaseBytes + kGrowthPerByte * Eingabegröße ist.
+ * Auffällige Eingaben werden als "slow-<hash>" im Verzeichnis
+ * $LATEXPREPRO_FUZZ_ARTIFACTS (Standard: aktuelles Verzeichnis) abgelegt;
+ * anschließend bricht der Lauf mit abort() ab, damit libFuzzer die Eingabe
+ * zusätzlich minimieren kann.
+ *
+ * Aufbau einer Eingabe (durch '\0' getrennte Felder):
+ *   [0]  erstes Byte: Argumentanzahl (mod 4), Rest: Ersatztext des Makros \f
+ *   [1]  Dokumenttext (mehrzeilig)
+ *   [2…] Paare KEY, VALUE für \define (höchstens kMaxDefines)
+ */
+#include "hash_utils.h"
+#include "macro_utils.h"
+#include "preprocessor.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace {
+
+    constexpr uint64_t kBaseNanos = 50'000'000;     // 50 ms Grundbudget
+    constexpr uint64_t kNanosPerByte = 100'000;     // 100 µs je Eingabebyte
+    constexpr size_t kBaseBytes = 4096;
+    constexpr size_t kGrowthPerByte = 64;
+    constexpr size_t kGovernorFactor = 4;          // Governor-Grenzen relativ zum Wachstumsbudget
+    constexpr size_t kMaxDefines = 8;
+
+
+    std::vector<std::string_view> split_fields(std::string_view data) {
+        std::vector<std::string_view> fields;
+        size_t start = 0;
+        for (size_t pos = data.find('\0'); pos != std::string_view::npos; pos = data.find('\0', start)) {
+            fields.push_back(data.substr(start, pos - start));
+            start = pos + 1;
+        }
+        fields.push_back(data.substr(start));
+        return fields;
+    }
+
+
+    std::vector<SourceLine> to_lines(std::string_view text) {
+        std::vector<SourceLine> lines;
+        size_t start = 0;
+        int line_nr = 1;
+        while (start <= text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string_view::npos) {
+                end = text.size();
+            }
+            lines.push_back({ std::string(text.substr(start, end - start)), "fuzz.tex", line_nr++ });
+            start = end + 1;
+        }
+        return lines;
+    }
+
+
+    size_t total_bytes(const std::vector<SourceLine>& lines) {
+        size_t bytes = 0;
+        for (const SourceLine& sl : lines) {
+            bytes += sl.line.size() + 1;
+        }
+        return bytes;
+    }
+
+
+    // Legt die Eingabe als Reproduktionsfall ab und bricht ab.
+    [[noreturn]] void report_slow_input(std::string_view data, const char* reason, uint64_t value, uint64_t budget) {
+        const char* dir = std::getenv("LATEXPREPRO_FUZZ_ARTIFACTS");
+        char name[32];
+        std::snprintf(name, sizeof(name), "slow-%016llx",
+            static_cast<unsigned long long>(fnv1a(data)));
+        std::string path = std::string(dir ? dir : ".") + "/" + name;
+
+        std::ofstream out(path, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+        std::fprintf(stderr, "+++ Auffällige Eingabe (%s: %llu > %llu), gespeichert als %s +++\n",
+            reason, static_cast<unsigned long long>(value),
+            static_cast<unsigned long long>(budget), path.c_str());
+        std::abort();
+    }
+
+} // anonymer Namespace
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+
+    std::string_view input(reinterpret_cast<const char*>(data), size);
+    std::vector<std::string_view> fields = split_fields(input);
+    if (fields.size() < 2 || fields[0].empty()) {
+        return 0;
+    }
+
+    macro_spec spec{
+        "\\f",
+        static_cast<size_t>(static_cast<unsigned char>(fields[0][0]) % 4),
+        std::string(fields[0].substr(1))
+    };
+    std::vector<SourceLine> lines = to_lines(fields[1]);
+
+    std::unordered_map<std::string, std::string> defines;
+    for (size_t i = 2; i + 1 < fields.size() && defines.size() < kMaxDefines; i += 2) {
+        defines[std::string(fields[i])] = std::string(fields[i + 1]);
+    }
+
+    // Der Governor der Engine liegt um kGovernorFactor über dem
+    // Wachstumsbudget: Er begrenzt nur den Speicher des Fuzzers, während
+    // Ausgaben zwischen beiden Grenzen als Wachstumsfehler gemeldet werden.
+    // Gleiche Grenzen würden jede Expansion vor der Prüfung abbrechen.
+    size_t max_output = kBaseBytes + kGrowthPerByte * size;
+    ExpansionLimits limits;
+    limits.max_line_bytes = kGovernorFactor * max_output;
+    limits.max_document_bytes = kGovernorFactor * max_output;
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Argumentextraktion an jeder Klammerposition
+    for (const SourceLine& sl : lines) {
+        for (size_t pos = sl.line.find('{'); pos != std::string::npos; pos = sl.line.find('{', pos + 1)) {
+            size_t end_pos = 0;
+            extract_math_args(sl.line, pos, end_pos);
+        }
+    }
+
+    PreprocReport report;
+    ExpansionBudget budget(limits, total_bytes(lines));
+    std::vector<SourceLine> out = replace_text_macros(lines, defines);
+    out = simplify_macro_spec(out, spec, report, nullptr, &budget);
+
+    uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    uint64_t time_budget = kBaseNanos + kNanosPerByte * size;
+    if (elapsed > time_budget) {
+        report_slow_input(input, "Laufzeit ns", elapsed, time_budget);
+    }
+
+    size_t out_bytes = total_bytes(out);
+    if (out_bytes > max_output) {
+        report_slow_input(input, "Ausgabe Bytes", out_bytes, max_output);
+    }
+    return 0;
+}
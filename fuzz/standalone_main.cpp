@@ -0,0 +1,50 @@
+/**
+ * standalone_main.cpp
+ * Einfacher Treiber für Compiler ohne libFuzzer (z. B. GCC).
+ *
+ * Führt LLVMFuzzerTestOneInput für alle übergebenen Dateien bzw. alle
+ * Dateien der übergebenen Verzeichnisse aus, etwa um einen Korpus oder
+ * einen gespeicherten Reproduktionsfall nachzuspielen.
+ */
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+
+namespace {
+
+    void run_file(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    }
+
+} // anonymer Namespace
+
+
+int main(int argc, char* argv[]) {
+    size_t count = 0;
+    for (int i = 1; i < argc; i++) {
+        std::filesystem::path path(argv[i]);
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    run_file(entry.path());
+                    count++;
+                }
+            }
+        }
+        else {
+            run_file(path);
+            count++;
+        }
+    }
+    std::cout << count << " Eingabe(n) ohne Befund ausgeführt\n";
+    return 0;
+}
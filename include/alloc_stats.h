@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * alloc_stats.h
+ * Zählung von Heap-Allokationen für die Instrumentierungs-Build-Variante.
+ *
+ * Wird das Projekt mit -DLATEXPREPRO_ALLOC_STATS=ON gebaut, ersetzt
+ * alloc_stats.cpp die globalen operator new/delete und zählt Anzahl,
+ * Bytes und den Höchststand der gleichzeitig belegten Bytes. StageTimer
+ * ordnet diese Werte dem jeweils laufenden Verarbeitungsschritt zu.
+ *
+ * Ohne die Option liefern alle Funktionen 0 und verursachen keine Kosten.
+ */
+#include <cstddef>
+
+
+/**
+ * Momentaufnahme der globalen Allokationszähler.
+ */
+struct AllocSnapshot {
+    size_t allocations = 0;   // Anzahl aller bisherigen Allokationen
+    size_t bytes = 0;         // Summe aller bisher angeforderten Bytes
+    size_t live_bytes = 0;    // aktuell belegte Bytes
+};
+
+
+// true, wenn die Allokationszählung einkompiliert ist.
+constexpr bool alloc_stats_enabled() {
+#ifdef LATEXPREPRO_ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Liefert den aktuellen Stand der Zähler.
+AllocSnapshot alloc_snapshot();
+
+/**
+ * Beginnt einen Messabschnitt für den Höchststand der belegten Bytes.
+ *
+ * Rückgabe ist der bisherige Höchststand, der an alloc_end_scope()
+ * zurückgegeben werden muss (ermöglicht verschachtelte Abschnitte).
+ */
+size_t alloc_begin_scope();
+
+// Beendet einen Messabschnitt und liefert dessen Höchststand.
+size_t alloc_end_scope(size_t saved_peak);
+
+// Höchststand der belegten Bytes seit Programmstart.
+size_t alloc_peak_bytes();
+
+// Maximaler Resident Set Size des Prozesses in Bytes (0, falls unbekannt).
+size_t peak_rss_bytes();
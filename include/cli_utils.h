@@ -1,5 +1,7 @@
 #pragma once
 
+#include "expansion_budget.h"
+
 #include <string>
 #include <vector>
 #include <optional>
@@ -24,6 +26,39 @@ struct CliConfig {
 
     /// Pfad zur JSON-Datei mit Makrodefinitionen
     std::string macro_file = "macros.json";
+
+    /// Ausgabe der Laufzeitmessung: leer (aus), "table" oder "json"
+    std::string timings;
+
+    /// Zieldatei für Chrome/Perfetto-Trace-Events (leer = aus)
+    std::string trace_file;
+
+    /// Verzeichnis des persistenten Expansions-Caches (leer = aus)
+    std::string cache_dir;
+
+    /// Dateien überwachen und bei Änderungen neu verarbeiten
+    bool watch = false;
+
+    /// Source-Map (Ausgabezeile → Quelle) als <output_file>.map schreiben
+    bool source_map = false;
+
+    /// Zusätzliche Suchverzeichnisse für \include (-I, in Reihenfolge)
+    std::vector<std::string> include_dirs;
+
+    /// Threads zum parallelen Einlesen der Include-Dateien (0 = alle Kerne)
+    unsigned jobs = 1;
+
+    /// Include-Dateien ebenenweise gebündelt einlesen (Linux: io_uring)
+    bool batch_read = false;
+
+    /// Nur Abhängigkeiten schreiben (-M/--MF), keine Verarbeitung
+    bool dependencies = false;
+
+    /// Ziel der Abhängigkeiten (--MF, Standard: <output_file>.d)
+    std::string dependency_file;
+
+    /// Grenzen für die Makroexpansion (--max-depth, --max-line-bytes, ...)
+    ExpansionLimits limits;
 };
 
 /**
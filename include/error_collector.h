@@ -1,5 +1,7 @@
 #pragma once
 
+#include "pipeline_stats.h"
+
 #include <vector>
 #include <string>
 
@@ -13,6 +15,7 @@ struct PreprocError {
 
 struct PreprocReport {
     std::vector<PreprocError> errors;
+    PipelineStats stats;   // Laufzeitmessung (nur mit --timings aktiv)
 
     bool has_errors() const { return !errors.empty(); }
 };
\ No newline at end of file
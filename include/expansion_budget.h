@@ -0,0 +1,81 @@
+#pragma once
+
+/**
+ * expansion_budget.h
+ * Ressourcenlimits für die Expansion von Formatmakros.
+ *
+ * Ersatztexte, die ein Argument mehrfach verwenden (z. B. "__0____0__"),
+ * verdoppeln die Ausgabe mit jeder Verschachtelungsebene. Ohne Grenzen
+ * kann ein einzelnes Dokument so Speicher und Rechenzeit erschöpfen.
+ *
+ * Überschreitungen werden als Fehler im PreprocReport gemeldet:
+ *   - Verschachtelungstiefe: betroffener Aufruf bleibt unexpandiert.
+ *   - Zeilengröße: die restliche Zeile bleibt unexpandiert, die
+ *     Verarbeitung läuft mit der nächsten Zeile weiter.
+ *   - Dokumentgröße und Zeitlimit: die Expansion wird insgesamt abgebrochen.
+ *
+ * Die Limits gelten nur für Formatmakros. Die Dokumentgröße startet bei
+ * der Größe vor den Formatmakros (Includes und \define-Werte zählen also
+ * mit, werden selbst aber nicht begrenzt) und wächst mit jeder Ersetzung,
+ * auch mit Zeilen aus dem Zeilen-Cache.
+ */
+#include "error_collector.h"
+#include "source_line.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+/**
+ * Konfigurierbare Grenzen; 0 bedeutet jeweils unbegrenzt.
+ */
+struct ExpansionLimits {
+    size_t max_depth = 64;                         // verschachtelte Aufrufe desselben Makros
+    size_t max_line_bytes = size_t(1) << 20;       // Länge einer Zeile nach Expansion
+    size_t max_document_bytes = size_t(256) << 20; // Gesamtgröße der Ausgabe
+    std::chrono::milliseconds timeout{ 0 };        // Zeitlimit für alle Formatmakros
+};
+
+
+/**
+ * Verbrauch eines Laufs gegenüber den Limits.
+ *
+ * Die Frist beginnt mit der Konstruktion.
+ */
+class ExpansionBudget {
+public:
+    explicit ExpansionBudget(const ExpansionLimits& limits = {}, size_t document_bytes = 0);
+
+    const ExpansionLimits& limits() const { return limits_; }
+
+    // true, sobald Dokumentgröße oder Zeitlimit überschritten wurden.
+    bool exhausted() const { return exhausted_; }
+
+    // Prüft, ob ein Aufruf in Tiefe depth expandiert werden darf.
+    bool allow_depth(size_t depth, const SourceLine& sl, const std::string& macro, PreprocReport& report);
+
+    // Beginnt eine neue Dokumentzeile (setzt line_exceeded() zurück).
+    void begin_line() { line_exceeded_ = false; }
+
+    // true, wenn die aktuelle Zeile das Zeilenlimit überschritten hat.
+    bool line_exceeded() const { return line_exceeded_; }
+
+    // Prüft die Länge einer Zeile nach einer geplanten Ersetzung.
+    bool allow_line(size_t bytes, const SourceLine& sl, const std::string& macro, PreprocReport& report);
+
+    // Verbucht die Größenänderung des Dokuments durch eine Ersetzung.
+    // Nach einem Abbruch (exhausted()) false, ohne erneut zu melden.
+    bool add_document_bytes(int64_t delta, const SourceLine& sl, PreprocReport& report);
+
+    // Prüft das Zeitlimit; nach einem Abbruch wie oben.
+    bool check_deadline(const SourceLine& sl, PreprocReport& report);
+
+private:
+    ExpansionLimits limits_;
+    std::chrono::steady_clock::time_point deadline_;
+    int64_t document_bytes_;
+    bool exhausted_ = false;
+    bool line_exceeded_ = false;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+/**
+ * expansion_cache.h
+ * Größenbeschränkter Cache für Formatmakro-Expansionen.
+ *
+ * Schlüssel ist der Makroname zusammen mit dem unveränderten
+ * Argumenttext eines Aufrufs (z. B. "\frac" + "{1,2}"), Wert ist der
+ * fertig expandierte Ersatztext. Identische Aufrufe werden so nur einmal
+ * expandiert. Bei Erreichen der Kapazität wird der am längsten nicht
+ * verwendete Eintrag verdrängt (LRU).
+ */
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+
+class ExpansionCache {
+public:
+    static constexpr size_t kDefaultCapacity = 4096;
+
+    explicit ExpansionCache(size_t capacity = kDefaultCapacity);
+
+    // Bildet den Schlüssel aus Makroname und rohem Argumenttext.
+    static std::string make_key(const std::string& macro, const std::string& raw_args);
+
+    /**
+     * Sucht einen Eintrag und zählt Treffer bzw. Fehlversuche.
+     * Der Zeiger bleibt bis zum nächsten insert() gültig.
+     */
+    const std::string* find(const std::string& key);
+
+    // Legt einen Eintrag an und verdrängt ggf. den ältesten.
+    void insert(const std::string& key, std::string value);
+
+    size_t size() const { return index_.size(); }
+    size_t capacity() const { return capacity_; }
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+    size_t evictions() const { return evictions_; }
+
+private:
+    using Entry = std::pair<std::string, std::string>;   // Schlüssel, Expansion
+
+    size_t capacity_;
+    std::list<Entry> entries_;   // vorne = zuletzt verwendet
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    size_t evictions_ = 0;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+/**
+ * file_provider.h
+ * Austauschbare Quelle für Eingabe- und Include-Dateien.
+ *
+ * Die Include-Auflösung liest Dateien ausschließlich über einen
+ * FileProvider. Damit lässt sich der Präprozessor ohne temporäre Dateien
+ * einbetten (Quellen aus einem Speicher) und vollständig im Speicher testen.
+ *
+ *   DiskFileProvider     – reales Dateisystem (Standard)
+ *   MemoryFileProvider   – Dateiname → Inhalt im Speicher
+ *   OverlayFileProvider  – obere Quelle vor unterer (z. B. geänderte
+ *                          Dateien eines Editors über der Festplatte)
+ *
+ * Alle Leseoperationen sind const und dürfen parallel aufgerufen werden,
+ * solange die Quelle dabei nicht verändert wird.
+ */
+#include "source_line.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/**
+ * Identität einer physischen Datei, unabhängig von ihrer Schreibweise
+ * ("a.tex", "./a.tex", "../dir/a.tex", Hardlinks, Symlinks).
+ *
+ * Auf POSIX-Systemen (Gerät, Inode); Quellen ohne Dateisystem verwenden
+ * kSyntheticDevice und einen Hash des Namens.
+ */
+struct FileId {
+    static constexpr uint64_t kSyntheticDevice = ~uint64_t(0);
+
+    uint64_t device = 0;
+    uint64_t inode = 0;
+
+    bool operator==(const FileId&) const = default;
+};
+
+template <>
+struct std::hash<FileId> {
+    size_t operator()(const FileId& id) const noexcept {
+        return std::hash<uint64_t>{}(id.inode * 31 + id.device);
+    }
+};
+
+
+/**
+ * Liest mehrere Stapel nacheinander und hält dabei Ressourcen wie den
+ * io_uring-Ring über alle Stapel (z. B. einer Include-Auflösung) offen.
+ */
+class BatchReader {
+public:
+    virtual ~BatchReader() = default;
+
+    // Wie FileProvider::read_batch().
+    virtual std::vector<std::optional<std::string>> read(const std::vector<std::string>& names) = 0;
+};
+
+
+class FileProvider {
+public:
+    virtual ~FileProvider() = default;
+
+    // Liefert den Inhalt einer Datei oder std::nullopt, falls sie fehlt.
+    virtual std::optional<std::string> read(const std::string& name) const = 0;
+
+    // Liest eine Datei zeilenweise mit Herkunft (leer, falls sie fehlt).
+    virtual std::vector<SourceLine> read_lines(const std::string& name) const;
+
+    // true, wenn die Datei existiert (Standard: über read()).
+    virtual bool exists(const std::string& name) const;
+
+    /**
+     * Identität der Datei oder std::nullopt, falls sie fehlt.
+     * Standard: synthetische Identität aus dem Namen, sofern exists().
+     */
+    virtual std::optional<FileId> identity(const std::string& name) const;
+
+    // Liest mehrere Dateien auf einmal (Standard: einzeln über read()).
+    virtual std::vector<std::optional<std::string>> read_batch(const std::vector<std::string>& names) const;
+
+    // Leser für mehrere Stapel (Standard: read_batch() je Stapel).
+    virtual std::unique_ptr<BatchReader> batch_reader() const;
+};
+
+
+class DiskFileProvider : public FileProvider {
+public:
+    std::optional<std::string> read(const std::string& name) const override;
+    bool exists(const std::string& name) const override;
+    std::vector<SourceLine> read_lines(const std::string& name) const override;
+
+    // (Gerät, Inode) über einen einzigen stat()-Aufruf.
+    std::optional<FileId> identity(const std::string& name) const override;
+
+    // Alle Dateien gebündelt über read_files_batch() (Linux: io_uring).
+    std::vector<std::optional<std::string>> read_batch(const std::vector<std::string>& names) const override;
+
+    // Ein io_uring-Ring für alle Stapel, eingerichtet beim ersten Stapel mit mehreren Dateien.
+    std::unique_ptr<BatchReader> batch_reader() const override;
+};
+
+
+class MemoryFileProvider : public FileProvider {
+public:
+    // Legt eine Datei an oder ersetzt ihren Inhalt.
+    void add(const std::string& name, std::string content);
+    void remove(const std::string& name) { files_.erase(name); }
+
+    std::optional<std::string> read(const std::string& name) const override;
+    bool exists(const std::string& name) const override { return files_.contains(name); }
+
+private:
+    std::unordered_map<std::string, std::string> files_;
+};
+
+
+class OverlayFileProvider : public FileProvider {
+public:
+    // Beide Quellen müssen den Overlay überleben.
+    OverlayFileProvider(const FileProvider& upper, const FileProvider& lower)
+        : upper_(upper), lower_(lower) {}
+
+    std::optional<std::string> read(const std::string& name) const override;
+    std::vector<SourceLine> read_lines(const std::string& name) const override;
+    bool exists(const std::string& name) const override;
+    std::optional<FileId> identity(const std::string& name) const override;
+
+private:
+    const FileProvider& upper_;
+    const FileProvider& lower_;
+};
+
+
+// Gemeinsamer Provider für das reale Dateisystem.
+const FileProvider& disk_file_provider();
@@ -1,19 +1,46 @@
 #pragma once
 
 #include "source_line.h"
+#include "source_map.h"
 #include "json.hpp"
 
 
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+class IoUringReader;
+
 // Liest den gesamten Inhalt einer Datei in einen String.
 std::vector<SourceLine> read_file_lines(const std::string& filename);
 
+// Liest mehrere Dateien gebündelt (Linux: io_uring, sonst einzeln).
+// std::nullopt für Dateien, die fehlen oder nicht lesbar sind.
+// reader: über mehrere Stapel wiederverwendeter Ring (nullptr → eigener Ring je Aufruf).
+std::vector<std::optional<std::string>> read_files_batch(const std::vector<std::string>& filenames,
+    IoUringReader* reader = nullptr);
+
+// Zerlegt Text im Speicher zeilenweise, Herkunft wie bei read_file_lines().
+std::vector<SourceLine> split_lines(const std::string& text, const std::string& filename);
+
+
+// Ergebnis von save_to_file().
+enum class SaveResult {
+    Written,     // Datei wurde (neu) geschrieben
+    Unchanged,   // Inhalt identisch, Datei unangetastet (mtime bleibt erhalten)
+    Failed       // Fehler beim Schreiben
+};
+
+// Speichert den Inhalt in eine Datei, sofern er sich vom bisherigen Inhalt unterscheidet.
+// Eine übergebene SourceMap wird dabei ohne zusätzlichen Durchlauf befüllt.
+SaveResult save_to_file(const std::string& filename, const std::vector<SourceLine>& content,
+    SourceMap* source_map = nullptr);
 
-// Speichert den Inhalt in eine Datei.
-void save_to_file(const std::string& filename, const std::vector<SourceLine>& content);
+// Schreibt eine make-kompatible Abhängigkeitsdatei ("target: prerequisites",
+// dazu leere Regeln für alle außer der ersten Voraussetzung). false bei Fehlern.
+bool write_dependency_file(const std::string& filename, const std::string& target,
+    const std::vector<std::string>& prerequisites);
 
 // Liest den Inhalt einer JSON-Datei und gibt das JSON-Objekt zurück.
 nlohmann::json read_json_config(const std::string& filename);
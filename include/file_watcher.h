@@ -0,0 +1,47 @@
+#pragma once
+
+/**
+ * file_watcher.h
+ * Überwachung von Dateien auf Änderungen (Watch-Modus, --watch).
+ *
+ * Unter Linux wird inotify verwendet. Überwacht werden die Verzeichnisse
+ * der angegebenen Dateien, damit auch Editoren erkannt werden, die beim
+ * Speichern eine neue Datei anlegen und umbenennen. Auf anderen
+ * Plattformen ist available() false.
+ */
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // true, wenn Dateiüberwachung auf dieser Plattform verfügbar ist.
+    bool available() const;
+
+    /**
+     * Legt die Menge der überwachten Dateien fest (Pfade wie im Dokument
+     * angegeben). Neue Verzeichnisse werden zusätzlich beobachtet.
+     */
+    void watch(const std::vector<std::string>& files);
+
+    /**
+     * Blockiert bis zur nächsten Änderung und liefert die geänderten
+     * Dateien in der Schreibweise, mit der sie an watch() übergeben wurden.
+     * Bereits wartende Folge-Ereignisse werden zusammengefasst.
+     */
+    std::vector<std::string> wait_for_changes();
+
+private:
+    int fd_ = -1;
+    std::unordered_map<int, std::string> dirs_;                        // Watch-Deskriptor → Verzeichnis
+    std::unordered_set<std::string> watched_dirs_;
+    std::unordered_map<std::string, std::vector<std::string>> files_;  // normalisierter Pfad → Schreibweisen
+};
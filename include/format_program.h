@@ -0,0 +1,56 @@
+#pragma once
+
+/**
+ * format_program.h
+ * Bytecode für die Ersatzmuster von Formatmakros.
+ *
+ * Ein Ersatzmuster wie "\frac{__0__}{__1__}" wird beim Laden der Makros
+ * einmal in eine kurze Befehlsfolge übersetzt:
+ *
+ *   Literal  – Textstück aus dem Literalpuffer ausgeben
+ *   Argument – Argument N ausgeben (bereits rekursiv expandiert)
+ *
+ * Die Ausführung schreibt die Expansion in einem Durchlauf in einen
+ * vorab passend reservierten Puffer. Der Aufwand ist damit proportional
+ * zur Ausgabe, statt wie beim wiederholten Suchen und Ersetzen der
+ * Platzhalter mit deren Anzahl und der Länge des Musters zu wachsen.
+ *
+ * Platzhalter werden von links nach rechts erkannt; eingesetzte Argumente
+ * werden nicht erneut nach Platzhaltern durchsucht.
+ */
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+class FormatProgram {
+public:
+    FormatProgram() = default;
+
+    // Übersetzt ein Ersatzmuster; Platzhalter ab arg_count bleiben Text.
+    static FormatProgram compile(std::string_view replacement, size_t arg_count);
+
+    // false für ein nicht übersetztes (default-konstruiertes) Programm.
+    bool compiled() const { return compiled_; }
+
+    // Länge der Ausgabe für diese Argumente, ohne sie zu erzeugen.
+    size_t output_size(const std::vector<std::string>& args) const;
+
+    // Hängt die Expansion an out an.
+    void run(const std::vector<std::string>& args, std::string& out) const;
+    std::string run(const std::vector<std::string>& args) const;
+
+private:
+    enum class Op : uint8_t { Literal, Argument };
+
+    struct Instruction {
+        Op op;
+        uint32_t operand;   // Literal: Offset im Literalpuffer, Argument: Index
+        uint32_t length;    // Literal: Länge
+    };
+
+    std::string literals_;
+    std::vector<Instruction> code_;
+    bool compiled_ = false;
+};
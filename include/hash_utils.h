@@ -0,0 +1,31 @@
+#pragma once
+
+/**
+ * hash_utils.h
+ * Einfache, plattformunabhängige 64-Bit-Hashfunktion (FNV-1a).
+ *
+ * Im Gegensatz zu std::hash ist das Ergebnis über Programmläufe und
+ * Compiler hinweg stabil und eignet sich daher für persistente Caches
+ * und Dateivergleiche.
+ */
+#include <cstdint>
+#include <string_view>
+
+
+constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+/**
+ * Führt einen bestehenden Hashwert mit weiteren Daten fort.
+ *
+ * Beispiel:
+ *   uint64_t h = fnv1a("abc");
+ *   h = fnv1a("def", h);   // == fnv1a("abcdef")
+ */
+inline uint64_t fnv1a(std::string_view data, uint64_t hash = kFnvOffsetBasis) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+ * include_resolver.h
+ * Auflösung von \include-Namen zu Dateipfaden.
+ *
+ * Ein relativer Name wird in dieser Reihenfolge gesucht:
+ *   1. relativ zum Verzeichnis der einbindenden Datei
+ *   2. relativ zum Arbeitsverzeichnis (bisheriges Verhalten)
+ *   3. in den Suchpfaden (-I) in der angegebenen Reihenfolge
+ * Absolute Namen werden unverändert verwendet.
+ *
+ * Ergebnisse (auch Fehlschläge) werden je (Name, Verzeichnis der
+ * einbindenden Datei) zwischengespeichert, sodass wiederholte \include
+ * derselben Datei keine weiteren Existenzprüfungen (stat) auslösen.
+ *
+ * Jede gefundene Datei wird über ihre FileId (Gerät, Inode) identifiziert,
+ * die bei der Existenzprüfung ohnehin anfällt. Zyklenerkennung und
+ * Datei-Cache verwenden die Identität bzw. den zuerst gefundenen Pfad
+ * (canonical) und greifen so unabhängig von der Schreibweise. Als
+ * SourceLine::file und als Basis für relative Includes dient dagegen
+ * weiterhin der Pfad der geschriebenen Schreibweise (path).
+ * Der Resolver ist threadsicher.
+ */
+#include "file_provider.h"
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+struct ResolvedInclude {
+    std::string path;        // gefundener Pfad dieser Schreibweise
+    FileId id;
+    std::string canonical;   // erster gefundener Pfad derselben Datei (Cache-Schlüssel)
+};
+
+
+class IncludeResolver {
+public:
+    explicit IncludeResolver(const FileProvider& provider, std::vector<std::string> search_paths = {});
+
+    /**
+     * Liefert Pfad und Identität der Datei, die name aus including_file
+     * heraus bezeichnet, oder std::nullopt.
+     */
+    std::optional<ResolvedInclude> resolve(const std::string& name, const std::string& including_file);
+
+    /**
+     * Liefert alle Pfade, unter denen name aus including_file heraus
+     * gesucht wird, in Suchreihenfolge – auch wenn keiner existiert.
+     */
+    std::vector<std::string> candidates(const std::string& name, const std::string& including_file) const;
+
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    std::vector<std::string> candidate_paths(const std::string& name, const std::string& including_dir) const;
+    std::optional<ResolvedInclude> search(const std::string& name, const std::string& including_dir) const;
+
+    const FileProvider& provider_;
+    std::vector<std::string> search_paths_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::optional<ResolvedInclude>> cache_;   // Name '\0' Verzeichnis → Datei
+    std::unordered_map<FileId, std::string> canonical_paths_;                 // Identität → erster Pfad
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
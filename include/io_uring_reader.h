@@ -0,0 +1,47 @@
+#pragma once
+
+/**
+ * io_uring_reader.h
+ * Gebündeltes, asynchrones Einlesen vieler Dateien über io_uring (Linux).
+ *
+ * Alle Lesevorgänge eines Stapels werden gemeinsam eingereicht, sodass
+ * die Speicherwarteschlange gefüllt bleibt, statt Datei für Datei zu
+ * warten. Die Schnittstelle wird direkt über Systemaufrufe angesprochen
+ * (keine liburing-Abhängigkeit).
+ *
+ * Ist io_uring nicht verfügbar (anderes Betriebssystem, älterer Kernel,
+ * per seccomp gesperrt), liefert available() false; Aufrufer lesen dann
+ * wie bisher einzeln (siehe read_files_batch() in file_utils.h).
+ */
+#include <optional>
+#include <string>
+#include <vector>
+
+
+class IoUringReader {
+public:
+    // Inhalt je Datei, std::nullopt für fehlende bzw. nicht lesbare Dateien
+    using Batch = std::vector<std::optional<std::string>>;
+
+    explicit IoUringReader(unsigned queue_depth = 64);
+    ~IoUringReader();
+
+    IoUringReader(const IoUringReader&) = delete;
+    IoUringReader& operator=(const IoUringReader&) = delete;
+
+    bool available() const { return ring_fd_ >= 0; }
+
+    /**
+     * Liest alle Dateien vollständig ein, Ergebnis in Reihenfolge der Pfade.
+     *
+     * std::nullopt, falls der Ring selbst versagt; der Reader ist danach
+     * nicht mehr available() und der Aufrufer liest auf anderem Weg.
+     */
+    std::optional<Batch> read_all(const std::vector<std::string>& paths);
+
+private:
+    struct Ring;
+
+    int ring_fd_ = -1;
+    Ring* ring_ = nullptr;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+/**
+ * latexprepro.h
+ * Öffentliche Schnittstelle der Kernbibliothek latexprepro_core.
+ *
+ * Ermöglicht die Nutzung des Präprozessors ohne eigenen Prozess und ohne
+ * Ein-/Ausgabedateien: Eingabetext und Makrotabelle werden im Speicher
+ * übergeben, Ergebnis und Fehlerbericht im Speicher zurückgegeben.
+ *
+ * Beispiel:
+ *   PreprocReport load_report;
+ *   MacroTable macros = parse_macro_table(nlohmann::json::parse(json_text), load_report);
+ *   // oder, für große Sammlungen: MacroLibrary macros(nlohmann::json::parse(json_text));
+ *
+ *   PreprocResult result = preprocess_text("\\frac{1,2}\n", "main.tex", macros);
+ *   if (!result.report.has_errors()) {
+ *       std::string latex = result.text();
+ *   }
+ */
+#include "error_collector.h"
+#include "macro_handler.h"
+#include "preprocessor.h"
+#include "source_line.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/**
+ * Einstellungen für einen Präprozessor-Lauf.
+ */
+struct PreprocOptions {
+    bool collect_stats = false;          // Laufzeitmessung in report.stats
+    IncludeOptions include_options;      // Datei-Cache, Dateiquelle, Parallelität der Includes
+    MacroOptions macro_options;          // Caches und Limits für die Makroanwendung
+};
+
+
+/**
+ * Ergebnis eines Präprozessor-Laufs.
+ */
+struct PreprocResult {
+    std::vector<SourceLine> lines;   // Ausgabezeilen inkl. Herkunft
+    PreprocReport report;            // Fehler und Messwerte
+
+    // Ausgabe als Text (jede Zeile mit abschließendem '\n').
+    std::string text() const;
+};
+
+
+/**
+ * Führt Include-Auflösung, Define-Extraktion und Makroanwendung auf
+ * bereits zeilenweise vorliegendem Inhalt aus.
+ *
+ * Fehler und Messwerte werden in einen bestehenden Bericht geschrieben,
+ * sodass Aufrufer eigene Schritte (Einlesen, Speichern) ergänzen können.
+ * options.collect_stats wird hier nicht ausgewertet; maßgeblich ist
+ * report.stats.enabled.
+ */
+std::vector<SourceLine> preprocess_lines(std::vector<SourceLine> content,
+    const MacroTable& macros,
+    PreprocReport& report,
+    const PreprocOptions& options = {});
+
+
+/**
+ * Wie oben, jedoch mit eigenem Bericht im Ergebnis.
+ */
+PreprocResult preprocess_lines(std::vector<SourceLine> content,
+    const MacroTable& macros,
+    const PreprocOptions& options = {});
+
+
+/**
+ * Wie oben, jedoch mit einer Makrosammlung, aus der nur die im Dokument
+ * verwendeten Makros instanziiert werden (nach Auflösung der Includes
+ * und Einsetzen der Defines).
+ */
+std::vector<SourceLine> preprocess_lines(std::vector<SourceLine> content,
+    const MacroLibrary& macros,
+    PreprocReport& report,
+    const PreprocOptions& options = {});
+
+
+/**
+ * Wie preprocess_lines(), jedoch für Text im Speicher.
+ *
+ * name wird als Dateiname der Zeilen verwendet (Fehlermeldungen, Source-Map).
+ */
+PreprocResult preprocess_text(const std::string& text,
+    const std::string& name,
+    const MacroTable& macros,
+    const PreprocOptions& options = {});
@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+ * line_cache.h
+ * Persistenter Cache für formatmakro-expandierte Zeilen (--cache-dir).
+ *
+ * Formatmakros wirken ausschließlich zeilenweise. Das Ergebnis einer Zeile
+ * hängt daher nur von ihrem Text (nach \define-Ersetzung, d. h. inklusive
+ * der aktiven Defines) und der Makrotabelle ab. Pro Makrotabelle wird eine
+ * Cache-Datei "format-<hash>.cache" angelegt, die Zeilentext → expandierte
+ * Zeile abbildet. Ändert sich die Makrotabelle, ändert sich der Dateiname
+ * und der Cache beginnt leer.
+ *
+ * Ohne load() arbeitet der Cache rein im Speicher (z. B. im Watch-Modus).
+ */
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+
+class LineCache {
+public:
+    static constexpr size_t kDefaultMaxEntries = 200000;
+
+    LineCache() = default;
+
+    /**
+     * Öffnet den Cache im Verzeichnis dir für die Makrotabelle table_hash.
+     * Eine vorhandene Cache-Datei wird eingelesen; fehlt sie, bleibt der
+     * Cache leer. Rückgabe false nur bei beschädigter Datei.
+     */
+    bool load(const std::string& dir, uint64_t table_hash);
+
+    /**
+     * Schreibt den Cache zurück. In diesem Lauf verwendete Einträge werden
+     * bevorzugt; insgesamt werden höchstens max_entries Einträge behalten.
+     */
+    bool save(size_t max_entries = kDefaultMaxEntries) const;
+
+    // Sucht die Expansion einer Zeile (zählt Treffer/Fehlversuche).
+    const std::string* find(const std::string& line);
+
+    // Merkt sich die Expansion einer Zeile.
+    void insert(const std::string& line, std::string expanded);
+
+    /**
+     * Beendet einen Lauf: behält höchstens max_entries Einträge (in diesem
+     * Lauf verwendete zuerst) und markiert alle als unbenutzt. Begrenzt den
+     * Speicher über viele Läufe (--watch); nach save() aufrufen.
+     */
+    void trim(size_t max_entries = kDefaultMaxEntries);
+
+    // Verwirft alle Einträge im Speicher (z. B. nach Änderung der Makrotabelle).
+    void clear() { entries_.clear(); }
+
+    bool is_open() const { return !path_.empty(); }
+    const std::string& path() const { return path_; }
+    size_t size() const { return entries_.size(); }
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    struct Entry {
+        std::string expanded;
+        bool used = false;   // in diesem Lauf gelesen oder geschrieben
+    };
+
+    std::string path_;
+    std::unordered_map<std::string, Entry> entries_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * line_features.h
+ * Kleine Merkmalsmaske je Zeile, mit der Verarbeitungsschritte Zeilen
+ * überspringen, die sie nicht betreffen können.
+ *
+ * Die meisten Prosazeilen enthalten weder '\' noch einen Define-Namen.
+ * Die Pipeline ermittelt die Merkmale einmal je Dokument und hält sie in
+ * einem eigenen Vektor neben dem Text (gleicher Index wie die Zeilen).
+ * replace_text_macros(), process_conditionals(), remove_defines() und
+ * simplify_macro_spec() nehmen diesen Vektor optional entgegen, prüfen
+ * die Merkmale in O(1), statt jede Zeile zu kopieren, zu trimmen und zu
+ * durchsuchen, und schreiben ihn passend zu ihrem Ergebnis fort.
+ * SourceLine selbst trägt keine Merkmale: Wer Zeilen außerhalb der
+ * Pipeline ändert, kann keine veralteten Masken hinterlassen.
+ *
+ * words ist ein Bloom-Filter (64 Bit, eine Hashfunktion) über alle
+ * Bezeichner der Zeile (Folgen aus Buchstaben, Ziffern und '_'):
+ * Ist das Bit eines Define-Namens nicht gesetzt, kommt er sicher nicht vor.
+ */
+#include "source_line.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+
+enum LineFeature : uint8_t {
+    kLineFeaturesKnown = 1 << 0,   // Merkmale ermittelt
+    kLineBackslash     = 1 << 1,   // enthält '\'
+    kLineBrace         = 1 << 2,   // enthält '{'
+    kLineDirective     = 1 << 3,   // beginnt (nach Leerraum) mit \define, \ifdef, \else oder \endif
+};
+
+
+struct LineFeatures {
+    uint8_t flags = 0;
+    uint64_t words = 0;
+
+    bool has(LineFeature feature) const { return (flags & feature) != 0; }
+
+    // false, wenn kein Bezeichner mit einem Bit aus word_mask vorkommt.
+    bool may_contain_words(uint64_t word_mask) const { return (words & word_mask) != 0; }
+};
+
+
+// Bit eines Bezeichners im Bloom-Filter LineFeatures::words.
+uint64_t word_bit(std::string_view word);
+
+// Ermittelt die Merkmale eines Zeilentexts.
+LineFeatures compute_line_features(std::string_view line);
+
+// Ermittelt die Merkmale aller Zeilen eines Texts.
+std::vector<LineFeatures> compute_line_features(const std::vector<SourceLine>& text);
+
+// Passt features an einen Text mit lines Zeilen an: Bei abweichender Länge
+// gelten alle Einträge als nicht ermittelt. nullptr bleibt nullptr.
+void fit_line_features(std::vector<LineFeatures>* features, size_t lines);
+
+// Merkmale der Zeile index (Text sl): gespeicherte aus features bzw. neu
+// ermittelte, die dann in features abgelegt werden (nullptr = nur ermitteln).
+LineFeatures line_features_at(std::vector<LineFeatures>* features, size_t index, const SourceLine& sl);
@@ -0,0 +1,32 @@
+#pragma once
+
+/**
+ * macro_codegen.h
+ * Übersetzt eine feste Makrosammlung zur Build-Zeit in C++-Quelltext.
+ *
+ * Das Werkzeug macro_codegen (tools/macro_codegen.cpp) erzeugt daraus
+ * eine Übersetzungseinheit mit einer constexpr-Tabelle aller Makros und
+ * builtin_macro_library(). Die Variante latexprepro_builtin linkt diese
+ * Einheit und kommt so ohne Einlesen und Parsen der JSON-Datei aus
+ * (CMake-Option LATEXPREPRO_BUILTIN_MACROS).
+ */
+#include "macro_handler.h"
+
+#include <string>
+
+
+/**
+ * Erzeugt den Quelltext für builtin_macro_library().
+ *
+ * Die Einträge werden nach Namen sortiert ausgegeben, sodass gleiche
+ * Makros stets dieselbe Datei ergeben. source erscheint als Herkunft in
+ * Fehlermeldungen und im Kopfkommentar.
+ */
+std::string generate_builtin_macros(const MacroTable& macros, const std::string& source);
+
+
+/**
+ * Die zur Build-Zeit eingebaute Makrosammlung.
+ * Nur in Programmen definiert, die die erzeugte Datei linken.
+ */
+MacroLibrary builtin_macro_library();
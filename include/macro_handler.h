@@ -2,9 +2,19 @@
 
 #include "source_line.h"
 #include "error_collector.h"
+#include "line_cache.h"
+#include "expansion_budget.h"
+#include "expansion_cache.h"
+#include "format_program.h"
+#include "line_features.h"
+#include "json.hpp"
 
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 
 // Makrotyp zur Unterscheidung von Format- und Logik-Makros
@@ -24,6 +34,21 @@ struct dynamic_macro {
     std::string name;                     // Makroname, z. B. \frac 
     size_t arg_count = 0;                 // Anzahl der Argumente für Format-Makros
     std::string replacement;              // Ersatztext (z. B. \frac{__0__}{__1__})
+    FormatProgram program;                // beim Laden übersetzter Ersatztext (nur Format-Makros)
+};
+
+// Makrotabelle wie von load_all_macros() / parse_macro_table() geliefert.
+using MacroTable = std::unordered_map<std::string, dynamic_macro>;
+
+/**
+ * Optionale Einstellungen für apply_all_macros().
+ */
+struct MacroOptions {
+    LineCache* line_cache = nullptr;            // Zeilen-Cache (--cache-dir, --watch), nullptr = aus
+    ExpansionCache* expansion_cache = nullptr;  // über Läufe erhaltener Expansions-Cache, nullptr = pro Aufruf
+    ExpansionLimits limits;                     // Grenzen für Tiefe, Ausgabegröße und Laufzeit
+    std::vector<LineFeatures>* line_features = nullptr;   // Zeilenmerkmale zum Eingabetext (line_features.h),
+                                                          // werden verbraucht; nullptr = je Schritt ermitteln
 };
 
 /**
@@ -31,13 +56,87 @@ struct dynamic_macro {
  */
 std::unordered_map<std::string, dynamic_macro> load_all_macros(const std::string& path, PreprocReport& report);
 
+/**
+ * Erzeugt die Makrotabelle aus bereits geparstem JSON (ohne Dateizugriff).
+ */
+std::unordered_map<std::string, dynamic_macro> parse_macro_table(const nlohmann::json& json_data,
+    PreprocReport& report,
+    const std::string& source = "<json>");
+
+/**
+ * Bildet einen stabilen Hash über alle Makrodefinitionen in der
+ * Reihenfolge, in der apply_all_macros() sie anwendet (nach Namen).
+ */
+uint64_t hash_macro_table(const std::unordered_map<std::string, dynamic_macro>& macros);
+
+
+/**
+ * Makrodefinitionen einer JSON-Datei, die erst bei Bedarf instanziiert werden.
+ *
+ * Große, gemeinsam genutzte Makrosammlungen belasten so kleine Dokumente
+ * nicht: instantiate() erzeugt nur die Formatmakros, deren Namen als
+ * Steuerwörter im Dokument vorkommen, sowie (transitiv) die, die deren
+ * Ersatztexte einführen. Logikmakros (\define, \ifdef, \include) und
+ * Namen, die keine Steuerwörter sind, werden immer instanziiert.
+ * Ungültige Einträge werden erst beim Instanziieren gemeldet.
+ */
+class MacroLibrary {
+public:
+    MacroLibrary() = default;
+    explicit MacroLibrary(nlohmann::json json, std::string source = "<json>");
+
+    // Bereits erzeugte Makros, z. B. eingebaute Tabellen (macro_codegen.h).
+    explicit MacroLibrary(MacroTable macros, std::string source = "<eingebaut>");
+
+    // Liest die JSON-Datei; Fehler wie load_all_macros().
+    static MacroLibrary load(const std::string& path, PreprocReport& report);
+
+    bool contains(const std::string& name) const { return json_.contains(name) || table_.count(name) > 0; }
+    size_t size() const { return json_.size() + table_.size(); }
+
+    // Makros, die in einem Text mit diesen Steuerwörtern wirksam werden können.
+    MacroTable instantiate(const std::unordered_set<std::string>& control_words, PreprocReport& report) const;
+
+    // Alle Makros (wie parse_macro_table()).
+    MacroTable instantiate_all(PreprocReport& report) const;
+
+    // Hash über die gesamte Sammlung, unabhängig davon, was instanziiert wird.
+    uint64_t hash() const { return hash_; }
+
+private:
+    std::optional<dynamic_macro> entry(const std::string& name, PreprocReport& report) const;
+
+    nlohmann::json json_ = nlohmann::json::object();
+    MacroTable table_;                  // alternativ zu json_: fertige Makros
+    std::string source_;
+    std::vector<std::string> always_;   // Logikmakros und Namen ohne Steuerwort-Form
+    uint64_t hash_ = 0;
+};
+
+
 /**
  * Wendet alle erkannten Makros (Format und Logik) auf den Eingabetext an.
+ *
+ * Formatmakros laufen in der Reihenfolge ihrer Namen; Durchläufe für
+ * Makros, die im Text (nach Einsetzen der Defines) nicht wirksam werden
+ * können, entfallen.
  */
 std::vector<SourceLine> apply_all_macros(const std::vector<SourceLine>& content,
     const std::unordered_map<std::string, dynamic_macro>& macros,
     const std::unordered_map<std::string, std::string>& defines,
-    PreprocReport& report
+    PreprocReport& report,
+    const MacroOptions& options = {}
+);
+
+/**
+ * Wie oben; die Formatmakros werden erst nach dem Einsetzen der Defines
+ * anhand der dann vorhandenen Steuerwörter aus library instanziiert.
+ */
+std::vector<SourceLine> apply_all_macros(const std::vector<SourceLine>& content,
+    const MacroLibrary& library,
+    const std::unordered_map<std::string, std::string>& defines,
+    PreprocReport& report,
+    const MacroOptions& options = {}
 );
 
 
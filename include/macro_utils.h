@@ -1,15 +1,23 @@
 #pragma once
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 #include "source_line.h"
 #include "error_collector.h"
+#include "expansion_budget.h"
+#include "expansion_cache.h"
+#include "format_program.h"
+#include "line_features.h"
 
 
 struct macro_spec {
     std::string name;          // z.B. "\frac", "\sqrt"
     size_t arg_count;          // Anzahl erwarteter Argumente
     std::string replacement;   // Format-String mit Platzhaltern, z. B. "\\frac{__0__}{__1__}"
+    const FormatProgram* program = nullptr;   // übersetztes replacement (nullptr → wird pro Aufruf übersetzt)
 };
 
 
@@ -19,9 +27,51 @@ std::vector<std::string> extract_math_args(const std::string& text, size_t start
 
 
 // Vereinfacht rekursiv ein bestimmtes Makro im Text anhand der übergebenen Spezifikation.
-std::vector<SourceLine> simplify_macro_spec(const std::vector<SourceLine>& text, const macro_spec& spec, PreprocReport& report);
+// Mit cache werden identische Aufrufe (Makro + roher Argumenttext) nur einmal expandiert,
+// budget begrenzt Verschachtelungstiefe, Ausgabegröße und Laufzeit. features enthält optional
+// die Zeilenmerkmale zu text (line_features.h) und wird passend zum Ergebnis fortgeschrieben.
+std::vector<SourceLine> simplify_macro_spec(const std::vector<SourceLine>& text, const macro_spec& spec, PreprocReport& report,
+    ExpansionCache* cache = nullptr, ExpansionBudget* budget = nullptr, std::vector<LineFeatures>* features = nullptr);
 
 
 // Ersetzt Platzhalter im Formatstring (z. B. "__0__") durch Argumente.
 std::string apply_format(const std::string& replacement, const std::vector<std::string>& args);
 
+
+// Sammelt alle Steuerwörter (Backslash + Buchstaben, z. B. "\frac") eines Textes.
+void collect_control_words(std::string_view text, std::unordered_set<std::string>& words);
+std::unordered_set<std::string> collect_control_words(const std::vector<SourceLine>& text);
+
+// true, wenn ein Formatstring mit umgebendem Text oder seinen Argumenten
+// ein Steuerwort bilden kann, das in keinem der Teile allein vorkommt.
+bool may_form_control_words(const std::string& replacement);
+
+
+// Position in einem Text aus mehreren Zeilen (Index in den Zeilen, Spalte).
+struct LinePosition {
+    size_t line;
+    size_t column;
+};
+
+// Sucht zur öffnenden Klammer bei open die schließende, auch über Zeilengrenzen
+// hinweg. Wie bei TeX endet ein Argument spätestens vor einer Leerzeile;
+// dann und am Textende: std::nullopt.
+std::optional<LinePosition> find_closing_brace(const std::vector<SourceLine>& text, LinePosition open);
+
+
+// Herkunft einer Zeile, die join_multiline_calls() zusammengefügt hat.
+struct JoinedLine {
+    size_t index;                    // Position im zusammengefügten Text
+    std::vector<SourceLine> parts;   // Originalzeilen (nur file und line_nr)
+};
+
+// Verbindet die Zeilen, über die sich die Argumente eines Aufrufs von names
+// erstrecken, durch '\n' zu einer Zeile mit der Herkunft der ersten.
+// joined erhält die Herkunft aller Teile.
+std::vector<SourceLine> join_multiline_calls(std::vector<SourceLine> text,
+    const std::vector<std::string>& names,
+    std::vector<JoinedLine>& joined);
+
+// Zerlegt die zusammengefügten Zeilen wieder an '\n'. Der j-te Teil erhält die
+// Herkunft der j-ten Originalzeile (überzählige Teile die der letzten).
+std::vector<SourceLine> split_joined_lines(std::vector<SourceLine> text, const std::vector<JoinedLine>& joined);
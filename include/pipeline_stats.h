@@ -0,0 +1,131 @@
+#pragma once
+
+/**
+ * pipeline_stats.h
+ * Laufzeit- und Durchsatzmessung der einzelnen Verarbeitungsschritte.
+ *
+ * Jeder Schritt der Pipeline (Include-Auflösung, Define-Ersetzung,
+ * einzelne Formatmakros, ...) kann über StageTimer bzw. run_stage
+ * vermessen werden. Die Messung ist nur aktiv, wenn
+ * PipelineStats::enabled gesetzt ist (CLI-Option --timings).
+ */
+#include "source_line.h"
+#include "alloc_stats.h"
+#include "trace.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+/**
+ * Messwerte eines einzelnen Verarbeitungsschritts.
+ */
+struct StageStats {
+    std::string name;        // Name des Schritts, z. B. "process_include"
+    int depth = 0;           // Verschachtelungstiefe (0 = Hauptschritt)
+    double wall_ms = 0.0;    // Laufzeit (Wanduhr) in Millisekunden
+    size_t in_lines = 0;     // Zeilen vor dem Schritt
+    size_t in_bytes = 0;     // Bytes vor dem Schritt (inkl. Zeilenumbrüche)
+    size_t out_lines = 0;    // Zeilen nach dem Schritt
+    size_t out_bytes = 0;    // Bytes nach dem Schritt (inkl. Zeilenumbrüche)
+
+    // Nur mit LATEXPREPRO_ALLOC_STATS befüllt (siehe alloc_stats.h)
+    size_t allocations = 0;  // Anzahl der Heap-Allokationen im Schritt
+    size_t alloc_bytes = 0;  // angeforderte Bytes im Schritt
+    size_t peak_live = 0;    // Höchststand der belegten Bytes im Schritt
+};
+
+
+/**
+ * Trefferzähler eines Caches.
+ */
+struct CacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+
+    double hit_rate() const {
+        size_t lookups = hits + misses;
+        return lookups ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+    }
+};
+
+
+/**
+ * Sammlung aller Messwerte eines Präprozessor-Laufs.
+ */
+struct PipelineStats {
+    bool enabled = false;              // Messung aktiv?
+    std::vector<StageStats> stages;    // Schritte in Aufrufreihenfolge
+    int depth = 0;                     // aktuelle Verschachtelungstiefe
+
+    CacheStats expansion_cache;        // Formatmakro-Expansionen (simplify_macro_spec)
+    CacheStats line_cache;             // persistenter Zeilen-Cache (--cache-dir)
+
+    bool output_unchanged = false;     // Ausgabedatei war bereits aktuell (nicht neu geschrieben)
+};
+
+
+/**
+ * Misst einen Verarbeitungsschritt vom Konstruktor bis zum Destruktor.
+ *
+ * Beispiel:
+ *   {
+ *       StageTimer timer(report.stats, "process_include", &content);
+ *       content = process_include(content, report, include_stack);
+ *       timer.set_output(content);
+ *   }
+ *
+ * Bei deaktivierter Messung sind Konstruktor und Destruktor leer.
+ * In Builds mit LATEXPREPRO_ALLOC_STATS werden zusätzlich die
+ * Allokationen des Schritts erfasst. Bei aktivem Tracing (--trace)
+ * wird der Schritt außerdem als Trace-Event aufgezeichnet.
+ */
+class StageTimer {
+public:
+    StageTimer(PipelineStats& stats, const std::string& name,
+        const std::vector<SourceLine>* input = nullptr);
+    ~StageTimer();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    // Hinterlegt das Ergebnis des Schritts für die Zeilen-/Byte-Zählung.
+    void set_output(const std::vector<SourceLine>& output);
+
+private:
+    PipelineStats& stats_;
+    TraceScope trace_;
+    size_t index_ = 0;   // Position des Eintrags in stats_.stages
+    std::chrono::steady_clock::time_point start_;
+    AllocSnapshot alloc_start_;
+    size_t saved_peak_ = 0;  // Höchststand des umgebenden Schritts
+};
+
+
+/**
+ * Führt einen zeilenbasierten Schritt aus und vermisst ihn.
+ *
+ * fn muss einen std::vector<SourceLine> zurückgeben.
+ */
+template <typename Fn>
+std::vector<SourceLine> run_stage(PipelineStats& stats, const std::string& name,
+    const std::vector<SourceLine>& input, Fn&& fn)
+{
+    if (!stats.enabled && !trace_enabled()) {
+        return fn();
+    }
+    StageTimer timer(stats, name, &input);
+    std::vector<SourceLine> output = fn();
+    timer.set_output(output);
+    return output;
+}
+
+
+// Gibt die Messwerte als Tabelle aus (inkl. Speicherwerten, falls erfasst).
+void print_stats_table(std::ostream& out, const PipelineStats& stats);
+
+// Serialisiert die Messwerte als JSON-Text.
+std::string stats_to_json(const PipelineStats& stats);
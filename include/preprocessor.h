@@ -11,11 +11,21 @@
  * preprocessor.cpp.
  */
 #include "error_collector.h"
+#include "file_provider.h"
+#include "line_features.h"
 #include "source_line.h"
 
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+
+
+/**
+ * Bereits gelesene Include-Dateien (Dateiname → Zeilen).
+ * Kann über mehrere Läufe hinweg weitergegeben werden (--watch).
+ */
+using FileCache = std::unordered_map<std::string, std::vector<SourceLine>>;
 
 
  /**
@@ -40,6 +50,74 @@ std::vector<SourceLine> process_include(const std::vector<SourceLine>& content,
 );
 
 
+/**
+ * Optionale Einstellungen für resolve_includes().
+ */
+struct IncludeOptions {
+    FileCache* file_cache = nullptr;              // über Läufe erhaltener Datei-Cache
+    const FileProvider* file_provider = nullptr;  // Quelle der Includes (nullptr → Dateisystem)
+    unsigned jobs = 1;                            // >1: Include-Baum parallel vorab lesen (0 = alle Kerne)
+    std::vector<std::string> search_paths;        // zusätzliche Suchverzeichnisse (-I)
+    bool batch_read = false;                      // Include-Baum ebenenweise gebündelt vorab lesen (Linux: io_uring)
+    std::vector<std::string>* missing_files = nullptr;  // erhält die Pfade nicht lesbarer Includes (--watch)
+};
+
+
+/**
+ * Löst \include-Anweisungen wie process_include() auf, öffnet aber keine
+ * Dateien aus \ifdef-Zweigen, deren Bedingung falsch ist.
+ *
+ * Die Bedingungen werden anhand der \define-KEYs des (wachsenden)
+ * Dokuments ausgewertet; die Auflösung wiederholt sich, bis sich die
+ * Menge der KEYs nicht mehr ändert. Jede Datei wird höchstens einmal gelesen.
+ *
+ * Mit evaluate_conditionals = false werden alle Zweige aufgelöst.
+ * Ein übergebener file_cache wird genutzt und ergänzt; nicht mehr
+ * eingefügte Dateien werden entfernt, seine Schlüssel sind danach also
+ * genau die eingefügten Include-Dateien. Gelesen wird über
+ * file_provider (nullptr → reales Dateisystem).
+ *
+ * Namen werden relativ zur einbindenden Datei, zum Arbeitsverzeichnis und
+ * zu den search_paths aufgelöst (siehe include_resolver.h); SourceLine::file
+ * enthält danach den gefundenen Pfad. Für nicht lesbare Includes landen in
+ * missing_files (falls gesetzt) der gefundene Pfad bzw. alle Suchpfade,
+ * damit der Watch-Modus auch auf das Anlegen der Datei reagiert.
+ *
+ * Mit jobs != 1 wird der Include-Baum zunächst von einem Work-Stealing-Pool
+ * parallel eingelesen (mit batch_read ebenenweise gebündelt), ebenfalls
+ * ohne Dateien aus verworfenen Zweigen; das Einfügen in Dokumentreihenfolge
+ * einschließlich Zyklenerkennung je Include-Pfad erfolgt anschließend
+ * sequenziell.
+ *
+ * \include-, \ifdef- und \define-Zeilen im Inhalt von verbatim-artigen
+ * Umgebungen (siehe protected_regions.h) bleiben in allen Schritten
+ * wirkungslos.
+ */
+std::vector<SourceLine> resolve_includes(const std::vector<SourceLine>& content,
+    PreprocReport& report,
+    bool evaluate_conditionals = true,
+    const IncludeOptions& options = {}
+);
+
+
+/**
+ * Listet alle Dateien, die content über \include (rekursiv) einbindet.
+ *
+ * Durchläuft nur den Include-Graphen wie process_include(): Defines,
+ * Bedingungen und Formatmakros werden nicht ausgewertet, Includes aus
+ * allen \ifdef-Zweigen zählen. Jede Datei erscheint einmal (Pfad und
+ * Reihenfolge ihres ersten Auftretens), Zyklen enden daher von selbst.
+ * Zeilen im Inhalt von verbatim-Umgebungen werden übersprungen.
+ * Nicht auffindbare Dateien werden in report eingetragen. Namensauflösung,
+ * Dateiquelle und Vorablesen wie bei resolve_includes(); ein Datei-Cache
+ * wird nur gelesen.
+ */
+std::vector<std::string> collect_include_dependencies(const std::vector<SourceLine>& content,
+    PreprocReport& report,
+    const IncludeOptions& options = {}
+);
+
+
 /**
  * Extrahiert alle \define-Makros aus dem Text.
  *
@@ -48,29 +126,45 @@ std::vector<SourceLine> process_include(const std::vector<SourceLine>& content,
  *   \define{DEBUG}
  *
  * Rückgabe ist eine Map KEY → VALUE (leerer Wert für flag-artige Defines).
+ * Verweise auf andere Defines in VALUE sind bereits eingesetzt. Zyklen
+ * (\define{A}{B}, \define{B}{A}) erzeugen eine Warnung, der schließende
+ * Schlüssel bleibt als Text stehen.
  *
  * Syntaxfehler (fehlende Klammern etc.) werden in report eingetragen.
  */
 std::unordered_map<std::string, std::string> extract_defines(const std::vector<SourceLine>& content, PreprocReport& report);
 
 
+/**
+ * Sammelt die KEYs aller gültigen \define-Anweisungen, ohne Fehler zu melden.
+ * Zeilen im Inhalt von verbatim-Umgebungen zählen nicht.
+ */
+std::unordered_set<std::string> collect_define_keys(const std::vector<SourceLine>& content);
+
+
 /**
  * Ersetzt alle vorkommenden Makro-Schlüssel durch ihre Werte.
  *
- * Die Ersetzung folgt exakten Textübereinstimmungen. 
+ * Die Ersetzung folgt exakten Textübereinstimmungen an Wortgrenzen, in
+ * einem Durchlauf je Zeile (längster Schlüssel zuerst). Eingesetzte Werte
+ * werden nicht erneut durchsucht.
  *
  * Beispiel:
  *   defines: NAME -> "Max"
  *   "Hallo NAME" -> "Hallo Max"
+ *
+ * features enthält optional die Zeilenmerkmale zu text; sie werden
+ * passend zum Ergebnis fortgeschrieben (ebenso in den folgenden Schritten).
  */
-std::vector<SourceLine> replace_text_macros(const std::vector<SourceLine>& text, const std::unordered_map<std::string, std::string>& macros);
+std::vector<SourceLine> replace_text_macros(const std::vector<SourceLine>& text, const std::unordered_map<std::string, std::string>& macros,
+    std::vector<LineFeatures>* features = nullptr);
 
 
 
 /**
  * Entfernt sämtliche \define-Anweisungen aus dem Quelltext.
  */
-std::vector<SourceLine> remove_defines(const std::vector<SourceLine>& content);
+std::vector<SourceLine> remove_defines(const std::vector<SourceLine>& content, std::vector<LineFeatures>* features = nullptr);
 
 /**
  * Verarbeitet \ifdef-Blöcke mit optionalem \else.
@@ -79,4 +173,5 @@ std::vector<SourceLine> remove_defines(const std::vector<SourceLine>& content);
  * - Keine Verschachtelung von \ifdef-Blöcken erlaubt
  * - Bedingungen prüfen ausschließlich auf Existenz in `defines`
  */
-std::vector<SourceLine> process_conditionals(const std::vector<SourceLine>& text, const std::unordered_map<std::string, std::string>& defines, PreprocReport& report);
+std::vector<SourceLine> process_conditionals(const std::vector<SourceLine>& text, const std::unordered_map<std::string, std::string>& defines, PreprocReport& report,
+    std::vector<LineFeatures>* features = nullptr);
@@ -0,0 +1,60 @@
+#pragma once
+
+/**
+ * protected_regions.h
+ * Bereiche eines Dokuments, die keine Verarbeitung erfahren dürfen.
+ *
+ * Geschützt sind:
+ *   - Kommentare: ab einem nicht maskierten '%' bis zum Zeilenende
+ *   - \verb|...| (Begrenzer beliebig, auch \verb*)
+ *   - der Inhalt von verbatim-artigen Umgebungen (verbatim, Verbatim,
+ *     BVerbatim, LVerbatim, lstlisting, minted, comment) bis vor \end{...};
+ *     die \begin-Zeile selbst (z. B. Optionen in [...]) wird verarbeitet
+ *
+ * hide() ermittelt die Bereiche einmal je Dokument und ersetzt jeden durch
+ * einen kurzen Platzhalter aus Steuerzeichen ("\x01" Index "\x02"). Alle
+ * folgenden Schritte (Defines, Bedingungen, Formatmakros) sehen die
+ * geschützten Bytes damit gar nicht erst; restore() setzt sie am Ende
+ * wieder ein. Platzhalter überstehen das Entfernen, Zusammenfügen und
+ * Vervielfältigen von Zeilen, da sie ihren Index selbst tragen.
+ */
+#include "source_line.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+class ProtectedRegions {
+public:
+    // Ersetzt alle geschützten Bereiche in text durch Platzhalter.
+    std::vector<SourceLine> hide(std::vector<SourceLine> text);
+
+    // Setzt die Bereiche anstelle ihrer Platzhalter wieder ein.
+    std::vector<SourceLine> restore(std::vector<SourceLine> text) const;
+
+    size_t size() const { return regions_.size(); }
+    bool empty() const { return regions_.empty(); }
+
+private:
+    std::vector<std::string> regions_;
+};
+
+
+/**
+ * Erkennt Zeilen, die im Inhalt einer verbatim-artigen Umgebung beginnen,
+ * nach denselben Regeln wie hide().
+ *
+ * Für Schritte vor hide(), die nur Anweisungen am Zeilenanfang auswerten
+ * (\include, \ifdef/\else/\endif, \define beim Einlesen der Includes):
+ * Kommentare beginnen dort ohnehin mit '%', nur verbatim-Inhalte müssen
+ * übersprungen werden. Die Zeilen sind in Dokumentreihenfolge zu übergeben.
+ */
+class VerbatimTracker {
+public:
+    // true, wenn line innerhalb einer verbatim-Umgebung beginnt; schreibt den Zustand fort.
+    bool protects(std::string_view line);
+
+private:
+    std::string environment_;   // aktuelle verbatim-Umgebung, leer = keine
+};
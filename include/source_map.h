@@ -0,0 +1,58 @@
+#pragma once
+
+/**
+ * source_map.h
+ * Kompakte Zuordnung Ausgabezeile → Quelldatei und Originalzeile.
+ *
+ * Aufeinanderfolgende Ausgabezeilen, die aus aufeinanderfolgenden Zeilen
+ * derselben Quelldatei stammen, werden zu einem Bereich zusammengefasst
+ * (Lauflängenkodierung). Ein Dokument ohne Includes und ohne entfernte
+ * Zeilen besteht so aus einem einzigen Bereich.
+ *
+ * Enthält eine Zeile '\n' (mehrzeiliges Ersetzungsmuster), belegt sie
+ * mehrere Ausgabezeilen; alle verweisen auf ihre Originalzeile.
+ *
+ * Dateiformat (JSON, Zeilennummern 1-basiert):
+ *   {"version":1,"files":["main.tex","kapitel.tex"],
+ *    "ranges":[ausgabe_start, anzahl, datei_id, original_start, ...]}
+ */
+#include "source_line.h"
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+class SourceMap {
+public:
+    struct Range {
+        int output_start;   // erste Ausgabezeile des Bereichs
+        int count;          // Anzahl Zeilen
+        int file_id;        // Index in files()
+        int original_start; // Originalzeile der ersten Ausgabezeile
+    };
+
+    struct Location {
+        std::string file;
+        int line;
+    };
+
+    // Hängt die Ausgabezeile(n) von sl an (in Ausgabereihenfolge).
+    void add(const SourceLine& sl);
+
+    // Liefert die Herkunft einer Ausgabezeile (1-basiert).
+    std::optional<Location> lookup(int output_line) const;
+
+    // Schreibt die Zuordnung als JSON-Datei.
+    bool write(const std::string& path) const;
+
+    const std::vector<std::string>& files() const { return files_; }
+    const std::vector<Range>& ranges() const { return ranges_; }
+
+private:
+    std::vector<std::string> files_;
+    std::unordered_map<std::string, int> file_ids_;
+    std::vector<Range> ranges_;
+    int next_output_line_ = 1;
+};
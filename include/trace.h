@@ -0,0 +1,62 @@
+#pragma once
+
+/**
+ * trace.h
+ * Aufzeichnung von Trace-Events im Chrome/Perfetto-Format.
+ *
+ * Mit --trace=datei.json wird jeder Verarbeitungsschritt, jede über
+ * \include eingelesene Datei und jeder Formatmakro-Durchlauf als
+ * "Complete Event" (ph = "X") aufgezeichnet. Die Datei kann in
+ * chrome://tracing oder https://ui.perfetto.dev geöffnet werden.
+ *
+ * Solange die Aufzeichnung nicht aktiviert ist, prüft TraceScope nur
+ * ein atomares Flag und legt keine Daten an.
+ */
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+
+namespace trace_detail {
+    extern std::atomic<bool> g_enabled;
+}
+
+// Aktiviert die Aufzeichnung (Zeitnullpunkt ist der Aufruf).
+void trace_enable();
+
+// Beendet die Aufzeichnung; bisherige Events bleiben für write_trace() erhalten.
+void trace_disable();
+
+// true, wenn Events aufgezeichnet werden.
+inline bool trace_enabled() {
+    return trace_detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+// Vergibt einen Anzeigenamen für den aufrufenden Thread (z. B. "worker 1").
+void trace_set_thread_name(const std::string& name);
+
+// Schreibt alle bisher aufgezeichneten Events als JSON-Datei.
+bool write_trace(const std::string& path);
+
+
+/**
+ * Zeichnet die Lebensdauer des Objekts als Trace-Event auf.
+ *
+ * Beispiel:
+ *   TraceScope scope("include", filename);
+ */
+class TraceScope {
+public:
+    TraceScope(const char* category, std::string_view name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    bool active_ = false;
+    const char* category_ = nullptr;
+    std::string name_;
+    std::chrono::steady_clock::time_point start_;
+};
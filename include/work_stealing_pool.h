@@ -0,0 +1,71 @@
+#pragma once
+
+/**
+ * work_stealing_pool.h
+ * Thread-Pool mit einer Aufgabenwarteschlange je Worker.
+ *
+ * Aufgaben, die ein Worker selbst erzeugt (z. B. die Includes einer gerade
+ * gelesenen Datei), landen in seiner eigenen Warteschlange und werden von
+ * ihm in LIFO-Reihenfolge abgearbeitet (Tiefensuche, warme Caches).
+ * Leerlaufende Worker stehlen Aufgaben vom anderen Ende fremder
+ * Warteschlangen, sodass sich unabhängige Teilbäume verteilen.
+ */
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * Startet threads Worker (0 → Anzahl der Hardware-Threads).
+     * Worker erhalten im Trace den Namen "<name> <n>".
+     */
+    explicit WorkStealingPool(unsigned threads = 0, const std::string& name = "worker");
+
+    // Beendet die Worker; noch nicht begonnene Aufgaben entfallen (vorher wait_idle()).
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * Reiht eine Aufgabe ein. Aus einem Worker heraus in dessen eigene
+     * Warteschlange, sonst reihum.
+     */
+    void submit(Task task);
+
+    // Blockiert, bis alle eingereihten (auch nachträglich erzeugten) Aufgaben erledigt sind.
+    void wait_idle();
+
+    unsigned size() const { return static_cast<unsigned>(queues_.size()); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void worker_loop(unsigned index, std::string name);
+    bool pop_local(unsigned index, Task& task);
+    bool steal(unsigned thief, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;     // neue Aufgaben oder Ende
+    std::condition_variable idle_;     // pending_ == 0
+    std::atomic<size_t> pending_{ 0 }; // eingereiht oder in Arbeit
+    std::atomic<size_t> queued_{ 0 };  // eingereiht, noch nicht entnommen
+    std::atomic<unsigned> next_queue_{ 0 };
+    bool stop_ = false;
+};
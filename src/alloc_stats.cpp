@@ -0,0 +1,160 @@
+#include "alloc_stats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+
+namespace {
+
+    std::atomic<size_t> g_allocations{ 0 };
+    std::atomic<size_t> g_bytes{ 0 };
+    std::atomic<size_t> g_live{ 0 };
+    std::atomic<size_t> g_peak{ 0 };        // Höchststand im aktuellen Abschnitt
+    std::atomic<size_t> g_total_peak{ 0 };  // Höchststand seit Programmstart
+
+    /**
+     * Hebt einen atomaren Höchststand an, falls value größer ist.
+     */
+    void raise_peak(std::atomic<size_t>& peak, size_t value) {
+        size_t current = peak.load(std::memory_order_relaxed);
+        while (value > current &&
+            !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+} // anonymer Namespace
+
+
+AllocSnapshot alloc_snapshot() {
+    return {
+        g_allocations.load(std::memory_order_relaxed),
+        g_bytes.load(std::memory_order_relaxed),
+        g_live.load(std::memory_order_relaxed)
+    };
+}
+
+
+size_t alloc_begin_scope() {
+    return g_peak.exchange(g_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+
+size_t alloc_end_scope(size_t saved_peak) {
+    // Höchststand des Abschnitts auslesen und für den umgebenden
+    // Abschnitt wieder auf das Maximum beider Werte setzen
+    size_t scope_peak = g_peak.load(std::memory_order_relaxed);
+    raise_peak(g_peak, saved_peak);
+    return scope_peak;
+}
+
+
+size_t alloc_peak_bytes() {
+    return g_total_peak.load(std::memory_order_relaxed);
+}
+
+
+/**
+ * Liefert den maximalen Resident Set Size des Prozesses.
+ *
+ * Linux meldet ru_maxrss in Kilobyte, macOS in Byte.
+ */
+size_t peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<size_t>(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+
+#ifdef LATEXPREPRO_ALLOC_STATS
+
+// ============================================================
+// Ersetzung der globalen Allokationsfunktionen
+// ============================================================
+//
+// Vor jedem Block wird dessen Größe abgelegt, damit auch das
+// unsized operator delete die belegten Bytes korrekt abziehen kann.
+
+namespace {
+
+    constexpr size_t kHeader = alignof(std::max_align_t);
+
+    void* counted_alloc(size_t size) noexcept {
+        void* base = std::malloc(size + kHeader);
+        if (!base) {
+            return nullptr;
+        }
+        *static_cast<size_t*>(base) = size;
+
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+        g_bytes.fetch_add(size, std::memory_order_relaxed);
+        size_t live = g_live.fetch_add(size, std::memory_order_relaxed) + size;
+        raise_peak(g_peak, live);
+        raise_peak(g_total_peak, live);
+
+        return static_cast<char*>(base) + kHeader;
+    }
+
+    void counted_free(void* ptr) noexcept {
+        if (!ptr) {
+            return;
+        }
+        char* base = static_cast<char*>(ptr) - kHeader;
+        g_live.fetch_sub(*reinterpret_cast<size_t*>(base), std::memory_order_relaxed);
+        std::free(base);
+    }
+
+} // anonymer Namespace
+
+
+void* operator new(size_t size) {
+    if (void* ptr = counted_alloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    if (void* ptr = counted_alloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept { counted_free(ptr); }
+void operator delete[](void* ptr) noexcept { counted_free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { counted_free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { counted_free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { counted_free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { counted_free(ptr); }
+
+#endif // LATEXPREPRO_ALLOC_STATS
@@ -49,6 +49,36 @@ std::optional<CliConfig> parse_cli_args(int argc, char* argv[]){
             ("m,macros", "Pfad zur Makrodefinition (JSON)",
                 cxxopts::value<std::string>()
                 ->default_value(get_default_macro_path().generic_string()))
+            ("timings", "Laufzeiten je Verarbeitungsschritt ausgeben (table|json)",
+                cxxopts::value<std::string>()
+                ->implicit_value("table"))
+            ("trace", "Trace-Events (Chrome/Perfetto-JSON) in Datei schreiben",
+                cxxopts::value<std::string>())
+            ("cache-dir", "Verzeichnis für den persistenten Expansions-Cache",
+                cxxopts::value<std::string>())
+            ("w,watch", "Eingabe, Includes und Makrodatei überwachen und bei Änderungen neu verarbeiten")
+            ("source-map", "Source-Map (Ausgabezeile -> Quelldatei/Zeile) als <ausgabe>.map schreiben")
+            ("I,include-dir", "Zusätzliches Suchverzeichnis für \\include (mehrfach möglich)",
+                cxxopts::value<std::vector<std::string>>())
+            ("j,jobs", "Include-Dateien mit N Threads parallel einlesen (0 = alle Kerne)",
+                cxxopts::value<unsigned>()
+                ->default_value("1"))
+            ("M,deps", "Nur Abhängigkeiten (\\include-Graph) als make-Regel schreiben, ohne Makroexpansion")
+            ("MF", "Datei für die Abhängigkeiten (impliziert -M, Standard: <ausgabe>.d)",
+                cxxopts::value<std::string>())
+            ("batch-read", "Include-Dateien ebenenweise gebündelt einlesen (Linux: io_uring)")
+            ("max-depth", "Maximale Verschachtelungstiefe von Formatmakros (0 = unbegrenzt)",
+                cxxopts::value<size_t>()
+                ->default_value(std::to_string(ExpansionLimits{}.max_depth)))
+            ("max-line-bytes", "Maximale Zeilenlänge nach Expansion in Bytes (0 = unbegrenzt)",
+                cxxopts::value<size_t>()
+                ->default_value(std::to_string(ExpansionLimits{}.max_line_bytes)))
+            ("max-output-bytes", "Maximale Größe der Ausgabe in Bytes (0 = unbegrenzt)",
+                cxxopts::value<size_t>()
+                ->default_value(std::to_string(ExpansionLimits{}.max_document_bytes)))
+            ("timeout", "Zeitlimit für die Makroexpansion in Millisekunden (0 = unbegrenzt)",
+                cxxopts::value<long long>()
+                ->default_value("0"))
             ("input", "Eingabedatei (Pflichtparameter)",
                 cxxopts::value<std::string>())
             ("h,help", "Hilfe anzeigen");
@@ -72,7 +102,56 @@ std::optional<CliConfig> parse_cli_args(int argc, char* argv[]){
         config.output_file = result["output"].as<std::string>();
         config.macro_file = result["macros"].as<std::string>();
 
-        
+        if (result.count("timings")) {
+            config.timings = result["timings"].as<std::string>();
+            if (config.timings != "table" && config.timings != "json") {
+                std::cerr << "Ungültiger Wert für --timings: " << config.timings
+                          << " (erwartet: table oder json)\n";
+                return std::nullopt;
+            }
+        }
+
+        if (result.count("trace")) {
+            config.trace_file = result["trace"].as<std::string>();
+        }
+
+        if (result.count("cache-dir")) {
+            config.cache_dir = result["cache-dir"].as<std::string>();
+        }
+
+        config.watch = result.count("watch") > 0;
+        config.source_map = result.count("source-map") > 0;
+
+        if (result.count("include-dir")) {
+            config.include_dirs = result["include-dir"].as<std::vector<std::string>>();
+        }
+
+        config.jobs = result["jobs"].as<unsigned>();
+        config.batch_read = result.count("batch-read") > 0;
+        if (config.batch_read && result.count("jobs")) {
+            std::cerr << "--batch-read und --jobs schließen sich aus "
+                      << "(gebündeltes Lesen verwendet keine Threads)\n";
+            return std::nullopt;
+        }
+
+        config.dependencies = result.count("deps") > 0 || result.count("MF") > 0;
+        if (config.dependencies) {
+            config.dependency_file = result.count("MF")
+                ? result["MF"].as<std::string>()
+                : config.output_file + ".d";
+        }
+
+        config.limits.max_depth = result["max-depth"].as<size_t>();
+        config.limits.max_line_bytes = result["max-line-bytes"].as<size_t>();
+        config.limits.max_document_bytes = result["max-output-bytes"].as<size_t>();
+        long long timeout = result["timeout"].as<long long>();
+        if (timeout < 0) {
+            std::cerr << "Ungültiger Wert für --timeout: " << timeout
+                      << " (erwartet: Millisekunden >= 0)\n";
+            return std::nullopt;
+        }
+        config.limits.timeout = std::chrono::milliseconds(timeout);
+
 
         return config; // Erfolgreich geparste Konfiguration zurückgeben
 
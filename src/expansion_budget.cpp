@@ -0,0 +1,77 @@
+#include "expansion_budget.h"
+
+
+ExpansionBudget::ExpansionBudget(const ExpansionLimits& limits, size_t document_bytes)
+    : limits_(limits),
+      deadline_(std::chrono::steady_clock::now() + limits.timeout),
+      document_bytes_(static_cast<int64_t>(document_bytes))
+{
+}
+
+
+bool ExpansionBudget::allow_depth(size_t depth, const SourceLine& sl, const std::string& macro, PreprocReport& report) {
+    if (limits_.max_depth == 0 || depth <= limits_.max_depth) {
+        return true;
+    }
+    report.errors.push_back({
+        sl.file,
+        "Maximale Verschachtelungstiefe (" + std::to_string(limits_.max_depth) +
+        ") bei '" + macro + "' überschritten",
+        sl.line_nr
+    });
+    return false;
+}
+
+
+bool ExpansionBudget::allow_line(size_t bytes, const SourceLine& sl, const std::string& macro, PreprocReport& report) {
+    if (limits_.max_line_bytes == 0 || bytes <= limits_.max_line_bytes) {
+        return true;
+    }
+    line_exceeded_ = true;
+    report.errors.push_back({
+        sl.file,
+        "Expansion von '" + macro + "' überschreitet das Zeilenlimit von " +
+        std::to_string(limits_.max_line_bytes) + " Bytes",
+        sl.line_nr
+    });
+    return false;
+}
+
+
+bool ExpansionBudget::add_document_bytes(int64_t delta, const SourceLine& sl, PreprocReport& report) {
+    // Abbruch nur einmal melden
+    if (exhausted_) {
+        return false;
+    }
+    document_bytes_ += delta;
+    if (limits_.max_document_bytes == 0 ||
+        document_bytes_ <= static_cast<int64_t>(limits_.max_document_bytes)) {
+        return true;
+    }
+    exhausted_ = true;
+    report.errors.push_back({
+        sl.file,
+        "Ausgabe überschreitet das Limit von " + std::to_string(limits_.max_document_bytes) +
+        " Bytes, Makroexpansion abgebrochen",
+        sl.line_nr
+    });
+    return false;
+}
+
+
+bool ExpansionBudget::check_deadline(const SourceLine& sl, PreprocReport& report) {
+    if (exhausted_) {
+        return false;
+    }
+    if (limits_.timeout.count() == 0 || std::chrono::steady_clock::now() < deadline_) {
+        return true;
+    }
+    exhausted_ = true;
+    report.errors.push_back({
+        sl.file,
+        "Zeitlimit von " + std::to_string(limits_.timeout.count()) +
+        " ms überschritten, Makroexpansion abgebrochen",
+        sl.line_nr
+    });
+    return false;
+}
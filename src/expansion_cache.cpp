@@ -0,0 +1,59 @@
+#include "expansion_cache.h"
+
+
+ExpansionCache::ExpansionCache(size_t capacity)
+    : capacity_(capacity)
+{
+}
+
+
+/**
+ * Der Makroname wird durch ein Nullzeichen vom Argumenttext getrennt,
+ * damit z. B. "\ab" + "s{x}" und "\abs" + "{x}" verschieden bleiben.
+ */
+std::string ExpansionCache::make_key(const std::string& macro, const std::string& raw_args) {
+    std::string key;
+    key.reserve(macro.size() + 1 + raw_args.size());
+    key += macro;
+    key += '\0';
+    key += raw_args;
+    return key;
+}
+
+
+const std::string* ExpansionCache::find(const std::string& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        misses_++;
+        return nullptr;
+    }
+
+    // Als zuletzt verwendet markieren
+    entries_.splice(entries_.begin(), entries_, it->second);
+    hits_++;
+    return &it->second->second;
+}
+
+
+void ExpansionCache::insert(const std::string& key, std::string value) {
+    if (capacity_ == 0) {
+        return;
+    }
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second->second = std::move(value);
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return;
+    }
+
+    // Ältesten Eintrag verdrängen
+    if (index_.size() >= capacity_) {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+        evictions_++;
+    }
+
+    entries_.emplace_front(key, std::move(value));
+    index_.emplace(key, entries_.begin());
+}
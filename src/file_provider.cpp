@@ -0,0 +1,193 @@
+#include "file_provider.h"
+#include "file_utils.h"
+#include "hash_utils.h"
+#include "io_uring_reader.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+
+namespace {
+
+    // Standard: jeder Stapel über FileProvider::read_batch()
+    class ProviderBatchReader : public BatchReader {
+    public:
+        explicit ProviderBatchReader(const FileProvider& provider) : provider_(provider) {}
+
+        std::vector<std::optional<std::string>> read(const std::vector<std::string>& names) override {
+            return provider_.read_batch(names);
+        }
+
+    private:
+        const FileProvider& provider_;
+    };
+
+
+    // Festplatte: ein io_uring-Ring für alle Stapel
+    class DiskBatchReader : public BatchReader {
+    public:
+        std::vector<std::optional<std::string>> read(const std::vector<std::string>& names) override {
+            if (names.size() > 1 && !ring_) {
+                ring_.emplace();
+            }
+            return read_files_batch(names, ring_ ? &*ring_ : nullptr);
+        }
+
+    private:
+        std::optional<IoUringReader> ring_;
+    };
+
+} // anonymer Namespace
+
+
+std::vector<SourceLine> FileProvider::read_lines(const std::string& name) const {
+    std::optional<std::string> content = read(name);
+    if (!content) {
+        return {};
+    }
+    return split_lines(*content, name);
+}
+
+
+bool FileProvider::exists(const std::string& name) const {
+    return read(name).has_value();
+}
+
+
+std::optional<FileId> FileProvider::identity(const std::string& name) const {
+    if (!exists(name)) {
+        return std::nullopt;
+    }
+    return FileId{ FileId::kSyntheticDevice, fnv1a(name) };
+}
+
+
+std::vector<std::optional<std::string>> FileProvider::read_batch(const std::vector<std::string>& names) const {
+    std::vector<std::optional<std::string>> result;
+    result.reserve(names.size());
+    for (const std::string& name : names) {
+        result.push_back(read(name));
+    }
+    return result;
+}
+
+
+std::unique_ptr<BatchReader> FileProvider::batch_reader() const {
+    return std::make_unique<ProviderBatchReader>(*this);
+}
+
+
+std::optional<std::string> DiskFileProvider::read(const std::string& name) const {
+    std::ifstream file(name, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+
+/**
+ * Direkt zeilenweise lesen, ohne den Dateiinhalt zwischenzuspeichern.
+ */
+std::vector<SourceLine> DiskFileProvider::read_lines(const std::string& name) const {
+    return read_file_lines(name);
+}
+
+
+bool DiskFileProvider::exists(const std::string& name) const {
+    std::error_code ec;
+    return std::filesystem::is_regular_file(name, ec);
+}
+
+
+/**
+ * Ohne Inodes (Windows) dient der kanonische Pfad als Identität.
+ */
+std::optional<FileId> DiskFileProvider::identity(const std::string& name) const {
+#ifndef _WIN32
+    struct stat st;
+    if (::stat(name.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return std::nullopt;
+    }
+    return FileId{ static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino) };
+#else
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(name, ec)) {
+        return std::nullopt;
+    }
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(name, ec);
+    return FileId{ FileId::kSyntheticDevice, fnv1a(canonical.generic_string()) };
+#endif
+}
+
+
+std::vector<std::optional<std::string>> DiskFileProvider::read_batch(const std::vector<std::string>& names) const {
+    return read_files_batch(names);
+}
+
+
+std::unique_ptr<BatchReader> DiskFileProvider::batch_reader() const {
+    return std::make_unique<DiskBatchReader>();
+}
+
+
+void MemoryFileProvider::add(const std::string& name, std::string content) {
+    files_[name] = std::move(content);
+}
+
+
+std::optional<std::string> MemoryFileProvider::read(const std::string& name) const {
+    auto it = files_.find(name);
+    if (it == files_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+
+std::optional<std::string> OverlayFileProvider::read(const std::string& name) const {
+    std::optional<std::string> content = upper_.read(name);
+    if (content) {
+        return content;
+    }
+    return lower_.read(name);
+}
+
+
+/**
+ * Die obere Quelle gewinnt auch bei leerem Inhalt; nur fehlende Dateien
+ * werden aus der unteren Quelle gelesen.
+ */
+std::vector<SourceLine> OverlayFileProvider::read_lines(const std::string& name) const {
+    std::optional<std::string> content = upper_.read(name);
+    if (content) {
+        return split_lines(*content, name);
+    }
+    return lower_.read_lines(name);
+}
+
+
+bool OverlayFileProvider::exists(const std::string& name) const {
+    return upper_.exists(name) || lower_.exists(name);
+}
+
+
+std::optional<FileId> OverlayFileProvider::identity(const std::string& name) const {
+    if (std::optional<FileId> id = upper_.identity(name)) {
+        return id;
+    }
+    return lower_.identity(name);
+}
+
+
+const FileProvider& disk_file_provider() {
+    static const DiskFileProvider provider;
+    return provider;
+}
@@ -1,4 +1,6 @@
 #include "file_utils.h"
+#include "hash_utils.h"
+#include "io_uring_reader.h"
 
 #include <fstream>
 #include <sstream>
@@ -52,15 +54,137 @@ std::vector<SourceLine> read_file_lines(const std::string& filename) {
 }
 
 
+/**
+ * Liest alle Dateien eines Stapels vollständig (binär) ein.
+ *
+ * Unter Linux werden alle Lesevorgänge gemeinsam über io_uring
+ * eingereicht, statt jede Datei einzeln mit ifstream zu öffnen und auf
+ * sie zu warten; das hält die Speicherwarteschlange gefüllt. Ist io_uring
+ * nicht verfügbar (älterer Kernel, seccomp, anderes Betriebssystem), wird
+ * wie bisher Datei für Datei gelesen.
+ *
+ * Mit reader wird der Ring eines Aufrufers verwendet, statt ihn für
+ * jeden Stapel neu einzurichten (io_uring_setup() und drei mmap()).
+ *
+ * Rückgabe: Inhalt je Datei in Reihenfolge von filenames, std::nullopt
+ * für fehlende bzw. nicht lesbare Dateien (ohne Meldung auf stderr).
+ */
+std::vector<std::optional<std::string>> read_files_batch(const std::vector<std::string>& filenames,
+    IoUringReader* reader)
+{
+    if (filenames.size() > 1) {
+        std::optional<IoUringReader> local_reader;
+        if (!reader) {
+            local_reader.emplace(static_cast<unsigned>(std::min<size_t>(filenames.size(), 64)));
+            reader = &*local_reader;
+        }
+        if (reader->available()) {
+            if (std::optional<IoUringReader::Batch> batch = reader->read_all(filenames)) {
+                return std::move(*batch);
+            }
+        }
+    }
+
+    std::vector<std::optional<std::string>> result;
+    result.reserve(filenames.size());
+    for (const std::string& filename : filenames) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            result.emplace_back();
+            continue;
+        }
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+        result.emplace_back(buffer.str());
+    }
+    return result;
+}
+
+
+/**
+ * Gegenstück zu read_file_lines() für Text im Speicher.
+ *
+ * Zeilen werden wie von std::getline getrennt; ein abschließender
+ * Zeilenumbruch erzeugt keine zusätzliche leere Zeile.
+ */
+std::vector<SourceLine> split_lines(const std::string& text, const std::string& filename) {
+
+    std::vector<SourceLine> result;
+    std::istringstream in(text);
+    std::string line;
+    int line_no = 1;
+
+    while (std::getline(in, line)) {
+        result.push_back({ line, filename, line_no++ });
+    }
+    return result;
+}
+
+
+namespace {
+
+    /**
+     * Prüft, ob eine vorhandene Datei die erwartete Größe und den
+     * erwarteten FNV-1a-Hash hat.
+     *
+     * Zuerst wird die Dateigröße verglichen; nur bei gleicher Größe wird
+     * die Datei blockweise gehasht. Sie wird nie vollständig geladen.
+     */
+    bool file_matches(const std::filesystem::path& path, uint64_t expected_size, uint64_t expected_hash) {
+
+        std::error_code ec;
+        uintmax_t file_size = std::filesystem::file_size(path, ec);
+        if (ec || file_size != expected_size) {
+            return false;   // Datei fehlt oder Größe weicht ab
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+
+        uint64_t hash = kFnvOffsetBasis;
+        char buffer[64 * 1024];
+        while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+            hash = fnv1a(std::string_view(buffer, static_cast<size_t>(in.gcount())), hash);
+        }
+        return hash == expected_hash;
+    }
+
+} // anonymer Namespace
+
+
 // Speichert den Inhalt in eine Datei.
+// Ist der Inhalt identisch mit der vorhandenen Datei, wird sie nicht
+// angefasst, damit nachgelagerte Builds (latexmk, make) nicht erneut laufen.
 // Parameter: 
-//   - filename: Pfad zur Zieldatei.
-//   - content:  Zu speichernder Textinhalt.
+//   - filename:   Pfad zur Zieldatei.
+//   - content:    Zu speichernder Textinhalt.
+//   - source_map: Optional; wird im selben Durchlauf über den Inhalt befüllt.
 // Rückgabe: 
-//   - Keine Rückgabe. Gibt Erfolg oder Fehler über die Konsole aus.
-void save_to_file(const std::string& filename, const std::vector<SourceLine>& content) {
+//   - Written, Unchanged oder Failed. Gibt Erfolg oder Fehler zusätzlich über die Konsole aus.
+SaveResult save_to_file(const std::string& filename, const std::vector<SourceLine>& content, SourceMap* source_map) {
     
     std::filesystem::path output_path(filename);
+
+    // Ein Durchlauf: Größe und Hash des neuen Inhalts (jede Zeile + '\n')
+    // sowie die Zuordnung Ausgabezeile → Herkunft
+    uint64_t new_size = 0;
+    uint64_t new_hash = kFnvOffsetBasis;
+    for (const SourceLine& sl : content) {
+        new_size += sl.line.size() + 1;
+        new_hash = fnv1a(sl.line, new_hash);
+        new_hash = fnv1a("\n", new_hash);
+        if (source_map) {
+            source_map->add(sl);
+        }
+    }
+
+    if (file_matches(output_path, new_size, new_hash)) {
+        std::cout << "Datei unverändert: " << filename << "\n";
+        return SaveResult::Unchanged;
+    }
+
     // Ordner automatisch erzeugen, falls nicht vorhanden
     try {
         std::filesystem::create_directories(output_path.parent_path());
@@ -68,18 +192,84 @@ void save_to_file(const std::string& filename, const std::vector<SourceLine>& co
     catch (const std::exception& e) {
         std::cerr << "+++ Fehler beim Erstellen der Verzeichnisse: " << e.what() << " +++\n";
     }
-    std::ofstream out(filename);
+    // Binär, damit die Datei genau die gehashten Bytes enthält (kein "\r\n" unter Windows)
+    std::ofstream out(filename, std::ios::binary);
     if (!out) {
         std::cerr << "+++ Fehler beim Öffnen der Datei zum Schreiben: " << filename << "+++\n";
-        return;
+        return SaveResult::Failed;
     }
     
     for (const SourceLine& sl : content) {
         out << sl.line << '\n';
     }
 
+    // Schreibfehler (voller Datenträger, Kontingent) zeigen sich oft erst beim Leeren des Puffers
     out.close();
+    if (out.fail()) {
+        std::cerr << "+++ Fehler beim Schreiben der Datei: " << filename << " +++\n";
+        return SaveResult::Failed;
+    }
     std::cout << "Datei gespeichert: " << filename << "\n";
+    return SaveResult::Written;
+}
+
+
+namespace {
+
+    /**
+     * Maskiert einen Pfad für make (Leerzeichen, '#', '$') wie gcc -MT:
+     * Backslashes direkt vor Leerraum oder '#' werden verdoppelt, da make
+     * 2N+1 Backslashes davor als N Backslashes und das Zeichen liest.
+     */
+    std::string make_escape(const std::string& path) {
+        std::string result;
+        size_t backslashes = 0;   // unmittelbar vorausgehende Backslashes
+        for (char c : path) {
+            if (c == ' ' || c == '\t' || c == '#') {
+                result.append(backslashes + 1, '\\');
+            }
+            else if (c == '$') {
+                result += '$';
+            }
+            result += c;
+            backslashes = (c == '\\') ? backslashes + 1 : 0;
+        }
+        return result;
+    }
+
+} // anonymer Namespace
+
+
+/**
+ * Schreibt eine make-kompatible Abhängigkeitsdatei (wie gcc -M -MP):
+ *
+ *   ausgabe.tex: main.tex \
+ *    kapitel1.tex
+ *
+ *   kapitel1.tex:
+ *
+ * Die leeren Regeln verhindern make-Fehler, wenn eine Datei entfernt wird.
+ * Geschrieben wird über save_to_file(), eine unveränderte Datei bleibt
+ * also unangetastet.
+ */
+bool write_dependency_file(const std::string& filename, const std::string& target,
+    const std::vector<std::string>& prerequisites)
+{
+    std::vector<SourceLine> lines{ { make_escape(target) + ":", filename, 0 } };
+    for (size_t i = 0; i < prerequisites.size(); i++) {
+        if (i > 0) {
+            lines.back().line += " \\";
+            lines.push_back({ "", filename, 0 });
+        }
+        lines.back().line += " " + make_escape(prerequisites[i]);
+    }
+
+    for (size_t i = 1; i < prerequisites.size(); i++) {
+        lines.push_back({ "", filename, 0 });
+        lines.push_back({ make_escape(prerequisites[i]) + ":", filename, 0 });
+    }
+
+    return save_to_file(filename, lines) != SaveResult::Failed;
 }
 
 // Liest den Inhalt einer JSON-Datei und gibt das JSON-Objekt zurück.
@@ -0,0 +1,146 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+    /**
+     * Normalisiert einen Pfad, damit "a.tex" und "./a.tex" übereinstimmen.
+     */
+    std::string normalize_path(const std::filesystem::path& path) {
+        std::error_code ec;
+        std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+        return (ec ? path : absolute).lexically_normal().generic_string();
+    }
+
+} // anonymer Namespace
+
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher()
+    : fd_(inotify_init1(IN_CLOEXEC))
+{
+    if (fd_ < 0) {
+        std::cerr << "+++ Fehler: inotify konnte nicht initialisiert werden +++\n";
+    }
+}
+
+
+FileWatcher::~FileWatcher() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+
+bool FileWatcher::available() const {
+    return fd_ >= 0;
+}
+
+
+void FileWatcher::watch(const std::vector<std::string>& files) {
+
+    files_.clear();
+
+    for (const std::string& file : files) {
+
+        std::string normalized = normalize_path(file);
+        std::vector<std::string>& spellings = files_[normalized];
+        if (std::find(spellings.begin(), spellings.end(), file) == spellings.end()) {
+            spellings.push_back(file);
+        }
+
+        std::string dir = std::filesystem::path(normalized).parent_path().generic_string();
+        if (watched_dirs_.contains(dir)) {
+            continue;
+        }
+
+        int wd = inotify_add_watch(fd_, dir.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MODIFY);
+        if (wd < 0) {
+            std::cerr << "+++ Warnung: Verzeichnis kann nicht überwacht werden: " << dir << " +++\n";
+            continue;
+        }
+        dirs_[wd] = dir;
+        watched_dirs_.insert(dir);
+    }
+}
+
+
+std::vector<std::string> FileWatcher::wait_for_changes() {
+
+    std::unordered_set<std::string> changed;
+    alignas(inotify_event) char buffer[16 * 1024];
+    int timeout_ms = -1;   // erstes Ereignis blockierend abwarten
+
+    for (;;) {
+        pollfd pfd{ fd_, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready <= 0) {
+            break;     // Fehler (z. B. Signal) oder keine weiteren Ereignisse
+        }
+
+        ssize_t len = read(fd_, buffer, sizeof(buffer));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char* ptr = buffer; ptr < buffer + len; ) {
+            auto* event = reinterpret_cast<inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            auto dir = dirs_.find(event->wd);
+            if (dir == dirs_.end() || event->len == 0) {
+                continue;
+            }
+
+            std::string path = dir->second + "/" + event->name;
+            auto file = files_.find(path);
+            if (file != files_.end()) {
+                changed.insert(file->first);
+            }
+        }
+
+        // Folge-Ereignisse (z. B. MODIFY + CLOSE_WRITE) nur einsammeln,
+        // solange sie bereits anstehen
+        timeout_ms = changed.empty() ? -1 : 0;
+    }
+
+    std::vector<std::string> result;
+    for (const std::string& normalized : changed) {
+        const auto& spellings = files_[normalized];
+        result.insert(result.end(), spellings.begin(), spellings.end());
+    }
+    return result;
+}
+
+#else
+
+FileWatcher::FileWatcher() = default;
+FileWatcher::~FileWatcher() = default;
+
+bool FileWatcher::available() const {
+    return false;
+}
+
+void FileWatcher::watch(const std::vector<std::string>& files) {
+    for (const std::string& file : files) {
+        files_[normalize_path(file)].push_back(file);
+    }
+}
+
+std::vector<std::string> FileWatcher::wait_for_changes() {
+    return {};
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include "format_program.h"
+
+#include <cctype>
+
+
+/**
+ * Zerlegt das Muster in Literale und Platzhalter "__N__" (N ohne führende
+ * Nullen, N < arg_count). Aufeinanderfolgender Text wird zu einem
+ * einzigen Literal zusammengefasst.
+ */
+FormatProgram FormatProgram::compile(std::string_view replacement, size_t arg_count) {
+
+    FormatProgram program;
+    program.compiled_ = true;
+
+    size_t literal_start = 0;
+
+    auto flush_literal = [&](size_t end) {
+        if (end > literal_start) {
+            program.code_.push_back({ Op::Literal,
+                static_cast<uint32_t>(program.literals_.size()),
+                static_cast<uint32_t>(end - literal_start) });
+            program.literals_.append(replacement.substr(literal_start, end - literal_start));
+        }
+    };
+
+    size_t pos = replacement.find("__");
+    while (pos != std::string_view::npos) {
+        size_t digits = pos + 2;
+        size_t index = 0;
+        while (digits < replacement.size() && std::isdigit(static_cast<unsigned char>(replacement[digits]))) {
+            index = index * 10 + static_cast<size_t>(replacement[digits] - '0');
+            digits++;
+        }
+
+        size_t count = digits - pos - 2;
+        bool placeholder = count > 0
+            && (count == 1 || replacement[pos + 2] != '0')
+            && replacement.substr(digits, 2) == "__"
+            && count <= 9 && index < arg_count;
+
+        if (!placeholder) {
+            pos = replacement.find("__", pos + 1);
+            continue;
+        }
+
+        flush_literal(pos);
+        program.code_.push_back({ Op::Argument, static_cast<uint32_t>(index), 0 });
+        literal_start = digits + 2;
+        pos = replacement.find("__", literal_start);
+    }
+    flush_literal(replacement.size());
+
+    return program;
+}
+
+
+size_t FormatProgram::output_size(const std::vector<std::string>& args) const {
+    size_t size = 0;
+    for (const Instruction& instruction : code_) {
+        if (instruction.op == Op::Literal) {
+            size += instruction.length;
+        }
+        else if (instruction.operand < args.size()) {
+            size += args[instruction.operand].size();
+        }
+    }
+    return size;
+}
+
+
+void FormatProgram::run(const std::vector<std::string>& args, std::string& out) const {
+    out.reserve(out.size() + output_size(args));
+    for (const Instruction& instruction : code_) {
+        if (instruction.op == Op::Literal) {
+            out.append(literals_, instruction.operand, instruction.length);
+        }
+        else if (instruction.operand < args.size()) {
+            out += args[instruction.operand];
+        }
+    }
+}
+
+
+std::string FormatProgram::run(const std::vector<std::string>& args) const {
+    std::string out;
+    run(args, out);
+    return out;
+}
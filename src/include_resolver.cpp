@@ -0,0 +1,88 @@
+#include "include_resolver.h"
+
+#include <filesystem>
+
+
+IncludeResolver::IncludeResolver(const FileProvider& provider, std::vector<std::string> search_paths)
+    : provider_(provider), search_paths_(std::move(search_paths))
+{
+}
+
+
+std::optional<ResolvedInclude> IncludeResolver::resolve(const std::string& name, const std::string& including_file) {
+
+    std::string including_dir = std::filesystem::path(including_file).parent_path().generic_string();
+    std::string key = name + '\0' + including_dir;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cache_.find(key);
+        if (it != cache_.end()) {
+            hits_++;
+            return it->second;
+        }
+        misses_++;
+    }
+
+    // Suche ohne Sperre; konkurrierende Suchen liefern dasselbe Ergebnis
+    std::optional<ResolvedInclude> resolved = search(name, including_dir);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (resolved) {
+        resolved->canonical = canonical_paths_.try_emplace(resolved->id, resolved->path).first->second;
+    }
+    return cache_.try_emplace(std::move(key), std::move(resolved)).first->second;
+}
+
+
+std::vector<std::string> IncludeResolver::candidates(const std::string& name, const std::string& including_file) const {
+    return candidate_paths(name, std::filesystem::path(including_file).parent_path().generic_string());
+}
+
+
+/**
+ * Kandidaten in der dokumentierten Reihenfolge (normalisiert).
+ */
+std::vector<std::string> IncludeResolver::candidate_paths(const std::string& name, const std::string& including_dir) const {
+
+    std::filesystem::path path(name);
+    if (path.is_absolute()) {
+        return { path.lexically_normal().generic_string() };
+    }
+
+    std::vector<std::string> candidates;
+    if (!including_dir.empty()) {
+        candidates.push_back((std::filesystem::path(including_dir) / path).lexically_normal().generic_string());
+    }
+    candidates.push_back(path.lexically_normal().generic_string());
+    for (const std::string& dir : search_paths_) {
+        candidates.push_back((std::filesystem::path(dir) / path).lexically_normal().generic_string());
+    }
+    return candidates;
+}
+
+
+/**
+ * Prüft die Kandidaten in der dokumentierten Reihenfolge.
+ */
+std::optional<ResolvedInclude> IncludeResolver::search(const std::string& name, const std::string& including_dir) const {
+
+    for (const std::string& candidate : candidate_paths(name, including_dir)) {
+        if (std::optional<FileId> id = provider_.identity(candidate)) {
+            return ResolvedInclude{ candidate, *id, candidate };
+        }
+    }
+    return std::nullopt;
+}
+
+
+size_t IncludeResolver::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+
+size_t IncludeResolver::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
@@ -0,0 +1,345 @@
+#include "io_uring_reader.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define LATEXPREPRO_HAVE_IO_URING 1
+#endif
+
+#ifdef LATEXPREPRO_HAVE_IO_URING
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace {
+
+    // Größter Einzelauftrag (len ist 32 Bit breit); längere Dateien in Teilen
+    constexpr size_t kMaxChunk = size_t(1) << 30;
+
+    int io_uring_setup(unsigned entries, io_uring_params* params) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    unsigned load_acquire(unsigned* p) {
+        return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+    }
+
+    void store_release(unsigned* p, unsigned value) {
+        std::atomic_ref<unsigned>(*p).store(value, std::memory_order_release);
+    }
+
+    template <typename T>
+    T* at(void* base, unsigned offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+
+    /**
+     * Liest den Rest einer Datei synchron (pread), z. B. wenn der Kernel
+     * IORING_OP_READ nicht kennt (vor Linux 5.6).
+     */
+    bool read_rest(int fd, std::string& data, size_t done) {
+        while (done < data.size()) {
+            ssize_t n = ::pread(fd, data.data() + done, data.size() - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                return false;
+            }
+            if (n == 0) {
+                data.resize(done);   // Datei ist seit fstat() geschrumpft
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+} // anonymer Namespace
+
+
+struct IoUringReader::Ring {
+    void* sq_ptr = MAP_FAILED;
+    size_t sq_size = 0;
+    void* cq_ptr = MAP_FAILED;
+    size_t cq_size = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size = 0;
+
+    unsigned entries = 0;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqes_size);
+        }
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) {
+            ::munmap(cq_ptr, cq_size);
+        }
+        if (sq_ptr != MAP_FAILED) {
+            ::munmap(sq_ptr, sq_size);
+        }
+    }
+};
+
+
+IoUringReader::IoUringReader(unsigned queue_depth) {
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    int fd = io_uring_setup(queue_depth, &params);
+    if (fd < 0) {
+        return;   // ENOSYS, EPERM (seccomp) …: available() bleibt false
+    }
+
+    Ring* ring = new Ring;
+    ring->entries = params.sq_entries;
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+    }
+
+    ring->sq_ptr = ::mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr != MAP_FAILED) {
+        ring->cq_ptr = single_mmap ? ring->sq_ptr
+            : ::mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    if (ring->cq_ptr != MAP_FAILED) {
+        ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        ring->sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, ring->sqes_size,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    }
+    if (ring->sqes == MAP_FAILED) {
+        delete ring;
+        ::close(fd);
+        return;
+    }
+
+    ring->sq_head = at<unsigned>(ring->sq_ptr, params.sq_off.head);
+    ring->sq_tail = at<unsigned>(ring->sq_ptr, params.sq_off.tail);
+    ring->sq_mask = at<unsigned>(ring->sq_ptr, params.sq_off.ring_mask);
+    ring->sq_array = at<unsigned>(ring->sq_ptr, params.sq_off.array);
+    ring->cq_head = at<unsigned>(ring->cq_ptr, params.cq_off.head);
+    ring->cq_tail = at<unsigned>(ring->cq_ptr, params.cq_off.tail);
+    ring->cq_mask = at<unsigned>(ring->cq_ptr, params.cq_off.ring_mask);
+    ring->cqes = at<io_uring_cqe>(ring->cq_ptr, params.cq_off.cqes);
+
+    ring_fd_ = fd;
+    ring_ = ring;
+}
+
+
+IoUringReader::~IoUringReader() {
+    if (ring_fd_ >= 0) {
+        ::close(ring_fd_);
+    }
+    delete ring_;
+}
+
+
+/**
+ * Ablauf:
+ *   1. Dateien werden erst beim Einreihen geöffnet (fstat liefert die
+ *      Größe des Puffers), sodass höchstens queue_depth Deskriptoren
+ *      gleichzeitig offen sind.
+ *   2. Die Übermittlungswarteschlange wird stets vollständig gefüllt und
+ *      mit einem einzigen io_uring_enter() eingereicht, das zugleich auf
+ *      mindestens eine Fertigmeldung wartet.
+ *   3. Kurze Lesevorgänge werden mit dem Rest erneut eingereiht; meldet
+ *      der Kernel einen Fehler (z. B. EINVAL ohne IORING_OP_READ), wird
+ *      die Datei synchron zu Ende gelesen.
+ *   4. Versagt io_uring_enter(), werden nicht übernommene Einträge
+ *      zurückgenommen und die übrigen abgewartet, bevor Puffer und
+ *      Deskriptoren freigegeben werden.
+ */
+std::optional<IoUringReader::Batch> IoUringReader::read_all(const std::vector<std::string>& paths) {
+
+    struct Job {
+        int fd = -1;
+        size_t done = 0;
+        bool ok = false;
+    };
+
+    const size_t n = paths.size();
+    std::vector<std::string> data(n);
+    std::vector<Job> jobs(n);
+    std::deque<size_t> requeued;
+    size_t next = 0;
+    unsigned in_flight = 0;
+    unsigned sq_tail = *ring_->sq_tail;
+
+    auto finish = [&](size_t i, bool ok) {
+        jobs[i].ok = ok;
+        ::close(jobs[i].fd);
+        jobs[i].fd = -1;
+    };
+
+    auto open_job = [&](size_t i) {
+        int fd = ::open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+        jobs[i].fd = fd;
+        data[i].resize(static_cast<size_t>(st.st_size));
+        if (data[i].empty()) {
+            finish(i, true);
+            return false;
+        }
+        return true;
+    };
+
+    // Wartet auf alle eingereichten Aufträge und verwirft ihre Ergebnisse.
+    // Die Fertigmeldungen erscheinen im gemeinsamen CQ-Ring auch dann,
+    // wenn io_uring_enter() selbst fehlschlägt; dann wird nur gepollt.
+    auto drain = [&](unsigned pending) {
+        while (pending > 0) {
+            unsigned cq_head = *ring_->cq_head;
+            unsigned cq_tail = load_acquire(ring_->cq_tail);
+            pending -= cq_tail - cq_head;
+            store_release(ring_->cq_head, cq_tail);
+            if (pending > 0 && io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+                ::usleep(100);
+            }
+        }
+    };
+
+    while (next < n || !requeued.empty() || in_flight > 0) {
+
+        // 1. Warteschlange füllen
+        while (in_flight < ring_->entries) {
+            size_t i;
+            if (!requeued.empty()) {
+                i = requeued.front();
+                requeued.pop_front();
+            }
+            else if (next < n) {
+                i = next++;
+                if (!open_job(i)) {
+                    continue;
+                }
+            }
+            else {
+                break;
+            }
+
+            unsigned slot = sq_tail & *ring_->sq_mask;
+            io_uring_sqe* sqe = &ring_->sqes[slot];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = jobs[i].fd;
+            sqe->off = jobs[i].done;
+            sqe->addr = reinterpret_cast<uint64_t>(data[i].data() + jobs[i].done);
+            sqe->len = static_cast<unsigned>(std::min(data[i].size() - jobs[i].done, kMaxChunk));
+            sqe->user_data = i;
+            ring_->sq_array[slot] = slot;
+            sq_tail++;
+            in_flight++;
+        }
+        store_release(ring_->sq_tail, sq_tail);
+
+        if (in_flight == 0) {
+            break;
+        }
+
+        // 2. Einreichen und warten; nicht übernommene Einträge erneut anbieten
+        unsigned to_submit = sq_tail - load_acquire(ring_->sq_head);
+        if (io_uring_enter(ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS) < 0
+            && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            // Nicht übernommene Einträge zurücknehmen; übernommene schreiben
+            // noch in die Puffer, daher erst nach ihrer Fertigmeldung aufräumen
+            unsigned sq_head = load_acquire(ring_->sq_head);
+            in_flight -= sq_tail - sq_head;
+            store_release(ring_->sq_tail, sq_head);
+            drain(in_flight);
+            for (Job& job : jobs) {
+                if (job.fd >= 0) {
+                    ::close(job.fd);
+                }
+            }
+            ::close(ring_fd_);
+            ring_fd_ = -1;
+            return std::nullopt;
+        }
+
+        // 3. Fertigmeldungen abholen
+        unsigned cq_head = *ring_->cq_head;
+        unsigned cq_tail = load_acquire(ring_->cq_tail);
+        for (; cq_head != cq_tail; cq_head++) {
+            const io_uring_cqe& cqe = ring_->cqes[cq_head & *ring_->cq_mask];
+            size_t i = static_cast<size_t>(cqe.user_data);
+            in_flight--;
+
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                requeued.push_back(i);
+            }
+            else if (cqe.res < 0) {
+                finish(i, read_rest(jobs[i].fd, data[i], jobs[i].done));
+            }
+            else if (cqe.res == 0) {
+                data[i].resize(jobs[i].done);   // Datei ist seit fstat() geschrumpft
+                finish(i, true);
+            }
+            else if ((jobs[i].done += static_cast<size_t>(cqe.res)) < data[i].size()) {
+                requeued.push_back(i);
+            }
+            else {
+                finish(i, true);
+            }
+        }
+        store_release(ring_->cq_head, cq_head);
+    }
+
+    Batch result(n);
+    for (size_t i = 0; i < n; i++) {
+        if (jobs[i].ok) {
+            result[i] = std::move(data[i]);
+        }
+    }
+    return result;
+}
+
+#else // ohne io_uring
+
+struct IoUringReader::Ring {};
+
+IoUringReader::IoUringReader(unsigned) {}
+
+IoUringReader::~IoUringReader() = default;
+
+std::optional<IoUringReader::Batch> IoUringReader::read_all(const std::vector<std::string>&) {
+    return std::nullopt;
+}
+
+#endif
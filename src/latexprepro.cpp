@@ -0,0 +1,119 @@
+#include "latexprepro.h"
+#include "file_utils.h"
+#include "pipeline_stats.h"
+#include "protected_regions.h"
+#include "line_features.h"
+
+#include <utility>
+
+
+std::string PreprocResult::text() const {
+    std::string out;
+    for (const SourceLine& sl : lines) {
+        out += sl.line;
+        out += '\n';
+    }
+    return out;
+}
+
+
+namespace {
+
+    /**
+     * Führt die Verarbeitungsschritte nach dem Einlesen aus:
+     *   1. Auflösen der \include-Anweisungen (lazy bzgl. \ifdef)
+     *   2. Ausblenden geschützter Bereiche (Kommentare, verbatim),
+     *      Ermitteln der Zeilenmerkmale (line_features.h)
+     *   3. Extraktion von \define-Makros
+     *   4. Anwendung aller dynamischen Makros
+     *   5. Wiedereinsetzen der geschützten Bereiche
+     *
+     * Jeder Schritt wird bei report.stats.enabled vermessen.
+     * Macros ist MacroTable oder MacroLibrary.
+     */
+    template <typename Macros>
+    std::vector<SourceLine> run_pipeline(std::vector<SourceLine> content,
+        const Macros& macros,
+        PreprocReport& report,
+        const PreprocOptions& options)
+    {
+        // Includes in verworfenen \ifdef-Zweigen werden nicht gelesen
+        content = run_stage(report.stats, "resolve_includes", content, [&] {
+            return resolve_includes(content, report, macros.contains("\\ifdef"), options.include_options);
+        });
+
+        // Kommentare und verbatim-Inhalte sehen die folgenden Schritte nicht
+        ProtectedRegions protected_regions;
+        content = run_stage(report.stats, "hide_protected_regions", content, [&] {
+            return protected_regions.hide(std::move(content));
+        });
+
+        // Zeilenmerkmale einmal ermitteln; die Schritte überspringen damit unbeteiligte Zeilen.
+        // Sie gehören der Pipeline und werden von den Makroschritten fortgeschrieben.
+        std::vector<LineFeatures> line_features;
+        {
+            StageTimer timer(report.stats, "line_features", &content);
+            line_features = compute_line_features(content);
+        }
+
+        // \define-Makros aus dem Text extrahieren
+        std::unordered_map<std::string, std::string> define_macros;
+        {
+            StageTimer timer(report.stats, "extract_defines", &content);
+            define_macros = extract_defines(content, report);
+        }
+
+        // Alle Makros anwenden
+        content = run_stage(report.stats, "apply_all_macros", content, [&] {
+            MacroOptions macro_options = options.macro_options;
+            macro_options.line_features = &line_features;
+            return apply_all_macros(content, macros, define_macros, report, macro_options);
+        });
+
+        if (protected_regions.empty()) {
+            return content;
+        }
+        return run_stage(report.stats, "restore_protected_regions", content, [&] {
+            return protected_regions.restore(std::move(content));
+        });
+    }
+
+} // anonymer Namespace
+
+
+std::vector<SourceLine> preprocess_lines(std::vector<SourceLine> content,
+    const MacroTable& macros,
+    PreprocReport& report,
+    const PreprocOptions& options)
+{
+    return run_pipeline(std::move(content), macros, report, options);
+}
+
+
+std::vector<SourceLine> preprocess_lines(std::vector<SourceLine> content,
+    const MacroLibrary& macros,
+    PreprocReport& report,
+    const PreprocOptions& options)
+{
+    return run_pipeline(std::move(content), macros, report, options);
+}
+
+
+PreprocResult preprocess_lines(std::vector<SourceLine> content,
+    const MacroTable& macros,
+    const PreprocOptions& options)
+{
+    PreprocResult result;
+    result.report.stats.enabled = options.collect_stats;
+    result.lines = preprocess_lines(std::move(content), macros, result.report, options);
+    return result;
+}
+
+
+PreprocResult preprocess_text(const std::string& text,
+    const std::string& name,
+    const MacroTable& macros,
+    const PreprocOptions& options)
+{
+    return preprocess_lines(split_lines(text, name), macros, options);
+}
@@ -0,0 +1,147 @@
+#include "line_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+
+namespace {
+
+    constexpr const char* kCacheHeader = "latexprepro-line-cache 1";
+
+    /**
+     * Liest genau count Bytes aus dem Stream.
+     */
+    bool read_exact(std::istream& in, std::string& out, size_t count) {
+        out.resize(count);
+        return count == 0 || static_cast<bool>(in.read(out.data(), static_cast<std::streamsize>(count)));
+    }
+
+} // anonymer Namespace
+
+
+/**
+ * Dateiformat:
+ *   latexprepro-line-cache 1\n
+ *   <Länge Zeile> <Länge Expansion>\n<Zeile><Expansion>\n
+ *   ...
+ *
+ * Die Längenangaben erlauben beliebige Zeichen (auch Zeilenumbrüche
+ * aus Ersetzungsmustern) im Inhalt.
+ */
+bool LineCache::load(const std::string& dir, uint64_t table_hash) {
+
+    std::ostringstream name;
+    name << "format-" << std::hex << table_hash << ".cache";
+    path_ = (std::filesystem::path(dir) / name.str()).string();
+    entries_.clear();
+
+    std::ifstream in(path_, std::ios::binary);
+    if (!in) {
+        return true;   // noch kein Cache vorhanden
+    }
+
+    std::string header;
+    if (!std::getline(in, header) || header != kCacheHeader) {
+        std::cerr << "+++ Warnung: Cache-Datei wird ignoriert (unbekanntes Format): " << path_ << " +++\n";
+        return false;
+    }
+
+    size_t line_len = 0;
+    size_t expanded_len = 0;
+    std::string line;
+    std::string expanded;
+
+    while (in >> line_len >> expanded_len) {
+        in.get();   // Zeilenumbruch nach den Längen
+        if (!read_exact(in, line, line_len) || !read_exact(in, expanded, expanded_len)) {
+            std::cerr << "+++ Warnung: Cache-Datei ist unvollständig: " << path_ << " +++\n";
+            entries_.clear();
+            return false;
+        }
+        in.get();   // abschließender Zeilenumbruch
+        entries_[line] = { expanded, false };
+    }
+    return true;
+}
+
+
+bool LineCache::save(size_t max_entries) const {
+
+    if (path_.empty()) {
+        return false;
+    }
+
+    try {
+        std::filesystem::create_directories(std::filesystem::path(path_).parent_path());
+    }
+    catch (const std::exception& e) {
+        std::cerr << "+++ Fehler beim Erstellen des Cache-Verzeichnisses: " << e.what() << " +++\n";
+        return false;
+    }
+
+    // Zuerst in eine temporäre Datei schreiben, dann umbenennen, damit
+    // parallele Läufe nie eine halb geschriebene Datei lesen
+    std::string tmp_path = path_ + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "+++ Fehler beim Schreiben des Caches: " << tmp_path << " +++\n";
+            return false;
+        }
+
+        out << kCacheHeader << "\n";
+
+        size_t written = 0;
+        for (bool used_pass : { true, false }) {
+            for (const auto& [line, entry] : entries_) {
+                if (entry.used != used_pass || written >= max_entries) {
+                    continue;
+                }
+                out << line.size() << ' ' << entry.expanded.size() << '\n'
+                    << line << entry.expanded << '\n';
+                written++;
+            }
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path_, ec);
+    if (ec) {
+        std::cerr << "+++ Fehler beim Speichern des Caches: " << ec.message() << " +++\n";
+        return false;
+    }
+    return true;
+}
+
+
+const std::string* LineCache::find(const std::string& line) {
+    auto it = entries_.find(line);
+    if (it == entries_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    it->second.used = true;
+    return &it->second.expanded;
+}
+
+
+void LineCache::insert(const std::string& line, std::string expanded) {
+    entries_[line] = { std::move(expanded), true };
+}
+
+
+void LineCache::trim(size_t max_entries) {
+    for (bool used_pass : { false, true }) {
+        for (auto it = entries_.begin(); it != entries_.end() && entries_.size() > max_entries; ) {
+            it = (it->second.used == used_pass) ? entries_.erase(it) : std::next(it);
+        }
+    }
+    for (auto& [line, entry] : entries_) {
+        entry.used = false;
+    }
+}
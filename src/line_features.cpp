@@ -0,0 +1,95 @@
+#include "line_features.h"
+#include "hash_utils.h"
+
+#include <array>
+
+
+namespace {
+
+    // Bezeichnerzeichen wie in replace_text_macros(): Buchstaben, Ziffern, '_'
+    constexpr std::array<bool, 256> kIdentChar = [] {
+        std::array<bool, 256> table{};
+        for (int c = 0; c < 256; c++) {
+            table[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+        return table;
+    }();
+
+} // anonymer Namespace
+
+
+uint64_t word_bit(std::string_view word) {
+    uint64_t hash = fnv1a(word);
+    return uint64_t{ 1 } << ((hash ^ (hash >> 32)) & 63);
+}
+
+
+LineFeatures compute_line_features(std::string_view line) {
+
+    LineFeatures features;
+    features.flags = kLineFeaturesKnown;
+
+    size_t first = line.find_first_not_of(" \t");
+    if (first != std::string_view::npos && line[first] == '\\') {
+        std::string_view rest = line.substr(first);
+        if (rest.starts_with("\\define") || rest.starts_with("\\ifdef") ||
+            rest.starts_with("\\else") || rest.starts_with("\\endif")) {
+            features.flags |= kLineDirective;
+        }
+    }
+
+    // FNV-1a des aktuellen Worts wird beim Lesen mitgeführt (wie word_bit())
+    uint64_t hash = kFnvOffsetBasis;
+    bool in_word = false;
+    for (unsigned char c : line) {
+        if (kIdentChar[c]) {
+            hash = (hash ^ c) * kFnvPrime;
+            in_word = true;
+            continue;
+        }
+        if (in_word) {
+            features.words |= uint64_t{ 1 } << ((hash ^ (hash >> 32)) & 63);
+            hash = kFnvOffsetBasis;
+            in_word = false;
+        }
+        if (c == '\\') {
+            features.flags |= kLineBackslash;
+        }
+        else if (c == '{') {
+            features.flags |= kLineBrace;
+        }
+    }
+    if (in_word) {
+        features.words |= uint64_t{ 1 } << ((hash ^ (hash >> 32)) & 63);
+    }
+    return features;
+}
+
+
+std::vector<LineFeatures> compute_line_features(const std::vector<SourceLine>& text) {
+    std::vector<LineFeatures> features;
+    features.reserve(text.size());
+    for (const SourceLine& sl : text) {
+        features.push_back(compute_line_features(sl.line));
+    }
+    return features;
+}
+
+
+void fit_line_features(std::vector<LineFeatures>* features, size_t lines) {
+    if (features && features->size() != lines) {
+        features->assign(lines, LineFeatures{});
+    }
+}
+
+
+LineFeatures line_features_at(std::vector<LineFeatures>* features, size_t index, const SourceLine& sl) {
+    if (!features) {
+        return compute_line_features(sl.line);
+    }
+    LineFeatures& stored = (*features)[index];
+    if (!stored.has(kLineFeaturesKnown)) {
+        stored = compute_line_features(sl.line);
+    }
+    return stored;
+}
@@ -0,0 +1,108 @@
+#include "macro_codegen.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+
+namespace {
+
+    /**
+     * Gibt text als C++-Stringliteral aus.
+     * Steuer- und Nicht-ASCII-Zeichen werden oktal maskiert (immer drei
+     * Ziffern, damit nachfolgende Ziffern nicht mitgelesen werden).
+     */
+    std::string cpp_string_literal(const std::string& text) {
+        std::string out = "\"";
+        for (unsigned char c : text) {
+            switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '"':  out += "\\\""; break;
+            case '\n': out += "\\n";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (c < 0x20 || c >= 0x7f) {
+                    char buffer[5];
+                    std::snprintf(buffer, sizeof(buffer), "\\%03o", c);
+                    out += buffer;
+                }
+                else {
+                    out += static_cast<char>(c);
+                }
+            }
+        }
+        return out + "\"";
+    }
+
+
+    const char* macro_type_name(macro_type type) {
+        switch (type) {
+        case macro_type::Format:      return "macro_type::Format";
+        case macro_type::Define:      return "macro_type::Define";
+        case macro_type::Include:     return "macro_type::Include";
+        case macro_type::Conditional: return "macro_type::Conditional";
+        }
+        return "macro_type::Format";
+    }
+
+} // anonymer Namespace
+
+
+std::string generate_builtin_macros(const MacroTable& macros, const std::string& source) {
+
+    std::vector<const dynamic_macro*> sorted;
+    for (const auto& [name, macro] : macros) {
+        sorted.push_back(&macro);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+        [](const dynamic_macro* a, const dynamic_macro* b) { return a->name < b->name; });
+
+    std::string out;
+    out += "// Erzeugt von macro_codegen aus " + source + " - nicht von Hand bearbeiten.\n";
+    out += "#include \"macro_codegen.h\"\n"
+           "\n"
+           "#include <cstddef>\n"
+           "#include <string_view>\n"
+           "#include <utility>\n"
+           "\n"
+           "\n"
+           "namespace {\n"
+           "\n"
+           "    struct BuiltinMacro {\n"
+           "        macro_type type;\n"
+           "        std::string_view name;\n"
+           "        size_t arg_count;\n"
+           "        std::string_view replacement;\n"
+           "    };\n"
+           "\n"
+           "    constexpr BuiltinMacro kBuiltinMacros[] = {\n";
+    for (const dynamic_macro* macro : sorted) {
+        out += "        { " + std::string(macro_type_name(macro->type)) + ", "
+            + cpp_string_literal(macro->name) + ", "
+            + std::to_string(macro->arg_count) + ", "
+            + cpp_string_literal(macro->replacement) + " },\n";
+    }
+    if (sorted.empty()) {
+        out += "        { macro_type::Define, \"\", 0, \"\" },   // Platzhalter für leere Sammlung\n";
+    }
+    out += "    };\n"
+           "\n"
+           "} // anonymer Namespace\n"
+           "\n"
+           "\n"
+           "MacroLibrary builtin_macro_library() {\n"
+           "    MacroTable macros;\n"
+           "    for (const BuiltinMacro& entry : kBuiltinMacros) {\n"
+           "        if (entry.name.empty()) {\n"
+           "            continue;\n"
+           "        }\n"
+           "        dynamic_macro& macro = macros[std::string(entry.name)];\n"
+           "        macro.type = entry.type;\n"
+           "        macro.name = std::string(entry.name);\n"
+           "        macro.arg_count = entry.arg_count;\n"
+           "        macro.replacement = std::string(entry.replacement);\n"
+           "    }\n"
+           "    return MacroLibrary(std::move(macros), " + cpp_string_literal(source) + ");\n"
+           "}\n";
+    return out;
+}
@@ -3,15 +3,19 @@
 #include "file_utils.h" 
 #include "macro_utils.h"
 #include "preprocessor.h"
+#include "hash_utils.h"
 #include <json.hpp>
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <optional>
 #include <vector>
 #include <unordered_set>
 
 
 /**
-    Lädt alle dynamischen Makros aus einer JSON-Datei (z. B. dynamic_macro.json).
+    Lädt alle dynamischen Makros aus einer JSON-Datei (z. B. dynamic_macro.json).
 
     Unterstützt folgende Typen: format, define, include, conditional.
 
@@ -19,31 +23,46 @@
     Rückgabe: Map vom Makronamen zum zugehörigen DynamicMacro-Eintrag.
 */
 std::unordered_map<std::string, dynamic_macro> load_all_macros(const std::string& path, PreprocReport& report) {
+    return MacroLibrary::load(path, report).instantiate_all(report);
+}
 
-    std::unordered_map<std::string, dynamic_macro> result;
-    nlohmann::json json_data = read_json_config(path);
 
-    if (json_data == nlohmann::json()) {
-        report.errors.push_back({
-            path,
-            "Makrodatei konnte nicht geladen werden",
-            -1
-        });
-        return{};
-    }
+namespace {
 
-    for (const auto& [name, entry] : json_data.items()) {
-        
+    /**
+     * Erzeugt ein Makro aus einem einzelnen JSON-Eintrag.
+     * Ungültige Einträge werden gemeldet, unbekannte Typen übersprungen.
+     */
+    std::optional<dynamic_macro> parse_macro_entry(const std::string& name,
+        const nlohmann::json& entry,
+        PreprocReport& report,
+        const std::string& source)
+    {
         dynamic_macro macro;
         macro.name = name;
-        
-        std::string type = entry["type"].get<std::string>();
+
+        std::string type;
+        try {
+            type = entry.at("type").get<std::string>();
+
+            if (type == "format") {
+                macro.arg_count = entry.at("arg_count").get<size_t>();
+                macro.replacement = entry.at("replacement").get<std::string>();
+            }
+        }
+        catch (const std::exception& e) {
+            report.errors.push_back({
+                source,
+                "Ungültige Makrodefinition '" + name + "': " + e.what(),
+                -1
+            });
+            return std::nullopt;
+        }
 
 
         if (type == "format") {
             macro.type = macro_type::Format;
-            macro.arg_count = entry["arg_count"].get<size_t>();
-            macro.replacement = entry["replacement"].get<std::string>();
+            macro.program = FormatProgram::compile(macro.replacement, macro.arg_count);
         }
         else if (type == "define") {
             macro.type = macro_type::Define;
@@ -56,58 +75,520 @@ std::unordered_map<std::string, dynamic_macro> load_all_macros(const std::string
         }
         else {
             std::cerr << "Unbekannter makro_typ: " << type << "\n";
-            continue;
+            return std::nullopt;
+        }
+        return macro;
+    }
+
+
+    // true für Namen der Form "\" + Buchstaben, wie sie collect_control_words() liefert
+    bool is_control_word(const std::string& name) {
+        return name.size() > 1 && name[0] == '\\' &&
+            std::all_of(name.begin() + 1, name.end(), [](char c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; });
+    }
+
+} // anonymer Namespace
+
+
+/**
+    Wandelt bereits geparstes JSON in eine Makrotabelle um.
+
+    Ermöglicht das Laden von Makros ohne Dateizugriff (z. B. bei
+    eingebetteter Nutzung über latexprepro.h).
+
+    Parameter: JSON-Objekt im Format von dynamic_macro.json,
+               Fehlerbericht, Herkunft für Fehlermeldungen (z. B. Dateipfad)
+    Rückgabe: Map vom Makronamen zum zugehörigen DynamicMacro-Eintrag.
+*/
+std::unordered_map<std::string, dynamic_macro> parse_macro_table(const nlohmann::json& json_data,
+    PreprocReport& report,
+    const std::string& source)
+{
+    std::unordered_map<std::string, dynamic_macro> result;
+
+    for (const auto& [name, entry] : json_data.items()) {
+        if (std::optional<dynamic_macro> macro = parse_macro_entry(name, entry, report, source)) {
+            result[name] = std::move(*macro);
         }
-        result[name] = macro;
     }
 
     return result;
 }
 
 /**
-    Wendet alle dynamischen Makros auf den Eingabetext an.
+    Bildet einen stabilen Hash über die Makrotabelle.
 
-    Parameter: Eingabe Text mit den Makros
-    Rückgabe: Ersetzter Text
+    Die Einträge werden nach Namen sortiert gehasht, da apply_all_macros()
+    die Formatmakros in dieser Reihenfolge anwendet und das Ergebnis
+    davon abhängen kann.
+
+    Parameter: Makrotabelle
+    Rückgabe: 64-Bit-FNV-1a-Hash
 */
-std::vector<SourceLine> apply_all_macros(
-    const std::vector<SourceLine>& content,
-    const std::unordered_map<std::string, dynamic_macro>& macros,
-    const std::unordered_map<std::string, std::string>& defines,
-    PreprocReport& report)
+uint64_t hash_macro_table(const std::unordered_map<std::string, dynamic_macro>& macros) {
+
+    std::vector<const dynamic_macro*> sorted;
+    for (const auto& [name, macro] : macros) {
+        sorted.push_back(&macro);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+        [](const dynamic_macro* a, const dynamic_macro* b) { return a->name < b->name; });
+
+    uint64_t hash = kFnvOffsetBasis;
+    for (const dynamic_macro* entry : sorted) {
+        const dynamic_macro& macro = *entry;
+        hash = fnv1a(macro.name, hash);
+        hash = fnv1a(std::string(1, '\0') + std::to_string(static_cast<int>(macro.type)), hash);
+        hash = fnv1a(std::string(1, '\0') + std::to_string(macro.arg_count), hash);
+        hash = fnv1a(std::string(1, '\0') + macro.replacement + '\0', hash);
+    }
+    return hash;
+}
+
+
+MacroLibrary::MacroLibrary(nlohmann::json json, std::string source)
+    : json_(std::move(json)), source_(std::move(source))
 {
-    std::vector<SourceLine> result = content;
+    if (!json_.is_object()) {
+        json_ = nlohmann::json::object();
+    }
+    for (const auto& [name, entry] : json_.items()) {
+        bool format = entry.is_object() && entry.value("type", std::string()) == "format";
+        if (!format || !is_control_word(name)) {
+            always_.push_back(name);
+        }
+    }
+    hash_ = fnv1a(json_.dump());
+}
 
 
+MacroLibrary MacroLibrary::load(const std::string& path, PreprocReport& report) {
 
-    // Defines entfernen
-    if (macros.contains("\\define")) {
-        result = remove_defines(result);
+    nlohmann::json json_data = read_json_config(path);
+
+    if (json_data == nlohmann::json()) {
+        report.errors.push_back({
+            path,
+            "Makrodatei konnte nicht geladen werden",
+            -1
+        });
+        return MacroLibrary();
     }
 
-    // Bedingungen (\ifdef)
-    if (macros.contains("\\ifdef")) {
-        result = process_conditionals(result, defines, report);
+    return MacroLibrary(std::move(json_data), path);
+}
+
+
+MacroLibrary::MacroLibrary(MacroTable macros, std::string source)
+    : table_(std::move(macros)), source_(std::move(source))
+{
+    for (auto& [name, macro] : table_) {
+        if (macro.type == macro_type::Format && !macro.program.compiled()) {
+            macro.program = FormatProgram::compile(macro.replacement, macro.arg_count);
+        }
+        if (macro.type != macro_type::Format || !is_control_word(name)) {
+            always_.push_back(name);
+        }
     }
+    hash_ = hash_macro_table(table_);
+}
+
 
-    if (!defines.empty()) {
-        result = replace_text_macros(result, defines);
+std::optional<dynamic_macro> MacroLibrary::entry(const std::string& name, PreprocReport& report) const {
+    if (auto it = table_.find(name); it != table_.end()) {
+        return it->second;
     }
-  
+    return parse_macro_entry(name, json_.at(name), report, source_);
+}
 
-    //  Formatmakros wie \frac, \sqrt usw.
-    for (const auto& [name, macro] : macros) {
-        if (macro.type == macro_type::Format) {
+
+/**
+ * Ausgehend von den Steuerwörtern des Textes werden die Ersatztexte der
+ * gefundenen Makros nach weiteren Steuerwörtern durchsucht, bis keine
+ * neuen hinzukommen. Kann ein Ersatztext mit seiner Umgebung neue
+ * Steuerwörter bilden (may_form_control_words()), wird alles instanziiert.
+ */
+MacroTable MacroLibrary::instantiate(const std::unordered_set<std::string>& control_words, PreprocReport& report) const {
+
+    PreprocReport lazy_report;
+    MacroTable result;
+
+    std::vector<std::string> pending = always_;
+    for (const std::string& word : control_words) {
+        if (contains(word)) {
+            pending.push_back(word);
+        }
+    }
+    std::unordered_set<std::string> seen(pending.begin(), pending.end());
+
+    while (!pending.empty()) {
+        std::string name = std::move(pending.back());
+        pending.pop_back();
+
+        std::optional<dynamic_macro> macro = entry(name, lazy_report);
+        if (!macro) {
+            continue;
+        }
+        if (macro->type == macro_type::Format) {
+            if (may_form_control_words(macro->replacement)) {
+                return instantiate_all(report);
+            }
+            std::unordered_set<std::string> introduced;
+            collect_control_words(macro->replacement, introduced);
+            for (const std::string& word : introduced) {
+                if (contains(word) && seen.insert(word).second) {
+                    pending.push_back(word);
+                }
+            }
+        }
+        result.emplace(name, std::move(*macro));
+    }
+
+    report.errors.insert(report.errors.end(), lazy_report.errors.begin(), lazy_report.errors.end());
+    return result;
+}
+
+
+MacroTable MacroLibrary::instantiate_all(PreprocReport& report) const {
+    if (!table_.empty()) {
+        return table_;
+    }
+    return parse_macro_table(json_, report, source_);
+}
+
+
+namespace {
+
+    /**
+     * Formatmakros, die in einem Text mit den Steuerwörtern words wirksam
+     * werden können (Abschluss über die Ersatztexte wie bei
+     * MacroLibrary::instantiate()), in Anwendungsreihenfolge (nach Namen).
+     */
+    std::vector<const dynamic_macro*> select_format_macros(const MacroTable& macros,
+        std::unordered_set<std::string> words)
+    {
+        std::vector<std::string> pending(words.begin(), words.end());
+        for (const auto& [name, macro] : macros) {
+            if (macro.type == macro_type::Format && !is_control_word(name) && words.insert(name).second) {
+                pending.push_back(name);
+            }
+        }
+
+        bool all = false;
+        while (!pending.empty() && !all) {
+            auto it = macros.find(pending.back());
+            pending.pop_back();
+            if (it == macros.end() || it->second.type != macro_type::Format) {
+                continue;
+            }
+            if (may_form_control_words(it->second.replacement)) {
+                all = true;
+                break;
+            }
+            std::unordered_set<std::string> introduced;
+            collect_control_words(it->second.replacement, introduced);
+            for (const std::string& word : introduced) {
+                if (words.insert(word).second) {
+                    pending.push_back(word);
+                }
+            }
+        }
+
+        std::vector<const dynamic_macro*> selected;
+        for (const auto& [name, macro] : macros) {
+            if (macro.type == macro_type::Format && (all || words.contains(name))) {
+                selected.push_back(&macro);
+            }
+        }
+        std::sort(selected.begin(), selected.end(),
+            [](const dynamic_macro* a, const dynamic_macro* b) { return a->name < b->name; });
+        return selected;
+    }
+
+
+    // Anzahl der Zeilen, die join_multiline_calls() in andere verschoben hat.
+    size_t joined_line_count(const std::vector<JoinedLine>& joined) {
+        size_t count = 0;
+        for (const JoinedLine& line : joined) {
+            count += line.parts.size() - 1;
+        }
+        return count;
+    }
+
+
+    /**
+     * Bringt die Zeilenmerkmale auf den Stand nach join_multiline_calls():
+     * Die Einträge verbundener Folgezeilen entfallen, die verbundene Zeile
+     * gilt als nicht ermittelt.
+     */
+    void join_line_features(std::vector<LineFeatures>& features, const std::vector<JoinedLine>& joined) {
+        if (joined.empty()) {
+            return;
+        }
+        std::vector<LineFeatures> result;
+        result.reserve(features.size() - joined_line_count(joined));
+        size_t source = 0;
+        for (const JoinedLine& line : joined) {
+            while (result.size() < line.index) {
+                result.push_back(features[source++]);
+            }
+            result.push_back(LineFeatures{});
+            source += line.parts.size();
+        }
+        result.insert(result.end(), features.begin() + source, features.end());
+        features.swap(result);
+    }
+
+
+    /**
+     * Wendet die Formatmakros nacheinander auf die Zeilen an.
+     * features (optional) gehört zu result und wird fortgeschrieben.
+     */
+    std::vector<SourceLine> run_format_passes(
+        std::vector<SourceLine> result,
+        const std::vector<const dynamic_macro*>& macros,
+        PreprocReport& report,
+        ExpansionCache& cache,
+        ExpansionBudget& budget,
+        std::vector<LineFeatures>* features)
+    {
+        for (const dynamic_macro* macro : macros) {
             macro_spec spec{
-                macro.name,
-                macro.arg_count,
-                macro.replacement
+                macro->name,
+                macro->arg_count,
+                macro->replacement,
+                &macro->program
             };
 
-            result = simplify_macro_spec(result, spec, report);
+            result = run_stage(report.stats, "simplify_macro_spec " + macro->name, result, [&] {
+                return simplify_macro_spec(result, spec, report, &cache, &budget, features);
+            });
         }
+        return result;
     }
 
-    return result;
+
+    /**
+     * Wendet die Formatmakros nur auf Zeilen an, die nicht im persistenten
+     * Zeilen-Cache liegen, und ergänzt den Cache um die neuen Ergebnisse.
+     *
+     * Zeilen ohne das Anfangszeichen eines Makronamens (üblicherweise '\\')
+     * können keine Formatmakros enthalten und werden nicht gecacht.
+     */
+    std::vector<SourceLine> run_format_passes_cached(
+        std::vector<SourceLine> result,
+        const std::vector<const dynamic_macro*>& macros,
+        PreprocReport& report,
+        ExpansionCache& cache,
+        ExpansionBudget& budget,
+        LineCache& line_cache,
+        std::vector<LineFeatures>* features)
+    {
+        std::string first_chars;
+        for (const dynamic_macro* macro : macros) {
+            if (!macro->name.empty() && first_chars.find(macro->name[0]) == std::string::npos) {
+                first_chars += macro->name[0];
+            }
+        }
+
+        std::vector<size_t> pending_index;
+        std::vector<SourceLine> pending;
+        std::vector<LineFeatures> pending_features;
+        fit_line_features(features, result.size());
+
+        for (size_t i = 0; i < result.size(); i++) {
+            SourceLine& sl = result[i];
+            if (sl.line.find_first_of(first_chars) == std::string::npos) {
+                continue;
+            }
+            if (const std::string* hit = line_cache.find(sl.line)) {
+                // Treffer zählen wie Expansionen gegen das Dokumentlimit
+                int64_t delta = static_cast<int64_t>(hit->size()) - static_cast<int64_t>(sl.line.size());
+                if (!budget.exhausted() && budget.add_document_bytes(delta, sl, report)) {
+                    sl.line = *hit;
+                    if (features) {
+                        (*features)[i] = LineFeatures{};
+                    }
+                }
+                continue;
+            }
+            pending_index.push_back(i);
+            pending.push_back(sl);
+            if (features) {
+                pending_features.push_back((*features)[i]);
+            }
+        }
+
+        size_t errors_before = report.errors.size();
+        std::vector<SourceLine> expanded = run_format_passes(pending, macros, report, cache, budget,
+            features ? &pending_features : nullptr);
+
+        // Fehlerhafte Läufe nicht cachen, damit die Fehler erneut gemeldet werden
+        bool cacheable = report.errors.size() == errors_before;
+
+        for (size_t j = 0; j < pending.size(); j++) {
+            if (cacheable) {
+                line_cache.insert(pending[j].line, expanded[j].line);
+            }
+            result[pending_index[j]].line = std::move(expanded[j].line);
+            if (features) {
+                (*features)[pending_index[j]] = pending_features[j];
+            }
+        }
+        return result;
+    }
+
+
+    /**
+     * Logikmakros: Defines entfernen, Bedingungen auswerten, Defines einsetzen.
+     */
+    std::vector<SourceLine> apply_logic_macros(
+        const std::vector<SourceLine>& content,
+        bool has_define,
+        bool has_ifdef,
+        const std::unordered_map<std::string, std::string>& defines,
+        PreprocReport& report,
+        std::vector<LineFeatures>* features)
+    {
+        std::vector<SourceLine> result = content;
+        PipelineStats& stats = report.stats;
+
+        // Defines entfernen
+        if (has_define) {
+            result = run_stage(stats, "remove_defines", result, [&] {
+                return remove_defines(result, features);
+            });
+        }
+
+        // Bedingungen (\ifdef)
+        if (has_ifdef) {
+            result = run_stage(stats, "process_conditionals", result, [&] {
+                return process_conditionals(result, defines, report, features);
+            });
+        }
+
+        if (!defines.empty()) {
+            result = run_stage(stats, "replace_text_macros", result, [&] {
+                return replace_text_macros(result, defines, features);
+            });
+        }
+        return result;
+    }
+
+
+    /**
+     * Formatmakros wie \frac, \sqrt usw. mit Caches und Ressourcenlimits.
+     */
+    std::vector<SourceLine> apply_format_macros(
+        std::vector<SourceLine> result,
+        const std::vector<const dynamic_macro*>& format_macros,
+        PreprocReport& report,
+        const MacroOptions& options)
+    {
+        PipelineStats& stats = report.stats;
+
+        //  Identische Aufrufe werden über den Cache nur einmal expandiert
+        ExpansionCache local_cache;
+        ExpansionCache& cache = options.expansion_cache ? *options.expansion_cache : local_cache;
+        size_t hits_before = cache.hits();
+        size_t misses_before = cache.misses();
+        size_t evictions_before = cache.evictions();
+
+        // Ressourcenlimits gelten für alle Formatmakros gemeinsam
+        size_t document_bytes = 0;
+        for (const SourceLine& sl : result) {
+            document_bytes += sl.line.size() + 1;
+        }
+        ExpansionBudget budget(options.limits, document_bytes);
+
+        // Aufrufe, deren Argumente über mehrere Zeilen reichen, vorübergehend zu einer Zeile verbinden
+        std::vector<std::string> names;
+        for (const dynamic_macro* macro : format_macros) {
+            names.push_back(macro->name);
+        }
+        std::vector<JoinedLine> joined;
+        result = join_multiline_calls(std::move(result), names, joined);
+
+        std::vector<LineFeatures>* features = options.line_features;
+        fit_line_features(features, result.size() + joined_line_count(joined));
+        if (features) {
+            join_line_features(*features, joined);
+        }
+
+        if (options.line_cache) {
+            size_t line_hits_before = options.line_cache->hits();
+            size_t line_misses_before = options.line_cache->misses();
+
+            result = run_format_passes_cached(result, format_macros, report, cache, budget, *options.line_cache, features);
+
+            stats.line_cache.hits += options.line_cache->hits() - line_hits_before;
+            stats.line_cache.misses += options.line_cache->misses() - line_misses_before;
+        }
+        else {
+            result = run_format_passes(result, format_macros, report, cache, budget, features);
+        }
+
+        stats.expansion_cache.hits += cache.hits() - hits_before;
+        stats.expansion_cache.misses += cache.misses() - misses_before;
+        stats.expansion_cache.evictions += cache.evictions() - evictions_before;
+
+        // Die Merkmale werden danach nicht mehr gebraucht
+        if (features) {
+            features->clear();
+        }
+        return split_joined_lines(std::move(result), joined);
+    }
+
+} // anonymer Namespace
+
+
+/**
+    Wendet alle dynamischen Makros auf den Eingabetext an.
+
+    Formatmakros, die im Text nach dem Einsetzen der Defines nicht
+    wirksam werden können, erhalten keinen eigenen Durchlauf.
+
+    Parameter: Eingabe Text mit den Makros, optionale Einstellungen
+               (z. B. persistenter Zeilen-Cache, Ressourcenlimits)
+    Rückgabe: Ersetzter Text
+*/
+std::vector<SourceLine> apply_all_macros(
+    const std::vector<SourceLine>& content,
+    const std::unordered_map<std::string, dynamic_macro>& macros,
+    const std::unordered_map<std::string, std::string>& defines,
+    PreprocReport& report,
+    const MacroOptions& options)
+{
+    std::vector<SourceLine> result = apply_logic_macros(content,
+        macros.contains("\\define"), macros.contains("\\ifdef"), defines, report, options.line_features);
+
+    std::vector<const dynamic_macro*> format_macros =
+        select_format_macros(macros, collect_control_words(result));
+    return apply_format_macros(std::move(result), format_macros, report, options);
 }
 
+
+/**
+    Wie oben, instanziiert die Makros aber erst nach dem Einsetzen der
+    Defines: Erst dann stehen alle Steuerwörter des Textes fest.
+*/
+std::vector<SourceLine> apply_all_macros(
+    const std::vector<SourceLine>& content,
+    const MacroLibrary& library,
+    const std::unordered_map<std::string, std::string>& defines,
+    PreprocReport& report,
+    const MacroOptions& options)
+{
+    std::vector<SourceLine> result = apply_logic_macros(content,
+        library.contains("\\define"), library.contains("\\ifdef"), defines, report, options.line_features);
+
+    std::unordered_set<std::string> control_words = collect_control_words(result);
+    MacroTable macros;
+    {
+        StageTimer timer(report.stats, "instantiate_macros");
+        macros = library.instantiate(control_words, report);
+    }
+
+    std::vector<const dynamic_macro*> format_macros = select_format_macros(macros, std::move(control_words));
+    return apply_format_macros(std::move(result), format_macros, report, options);
+}
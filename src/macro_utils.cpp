@@ -1,7 +1,11 @@
 
 #include "macro_utils.h"
 #include "preprocessor.h"
+#include "line_features.h"
 
+#include <algorithm>
+#include <cctype>
+#include <iterator>
 #include <iostream>
 #include <sstream>
 
@@ -80,23 +84,207 @@ std::vector<std::string> extract_math_args(const std::string& text, size_t start
  *     Der fertige String, in dem alle Platzhalter ersetzt wurden.
  */
 std::string apply_format(const std::string& replacement, const std::vector<std::string>& args) {
-    std::string result = replacement;
-    for (size_t i = 0; i < args.size(); i++) {
-        std::string placeholder = "__" + std::to_string(i) + "__";
-        size_t pos;
-        // Ersetze alle Vorkommen von "__i__" 
-        while ((pos = result.find(placeholder)) != std::string::npos) {
-
-            result.replace(pos, placeholder.length(), args[i]);
-        }
-    }
-
-    return result;
+    return FormatProgram::compile(replacement, args.size()).run(args);
 }
 
 
 
 
+namespace {
+
+	/**
+	 * Implementierung von simplify_macro_spec() mit Verschachtelungstiefe.
+	 *
+	 * depth ist 0 für Aufrufe im Dokument und wächst mit jeder Rekursion
+	 * in die Argumente. Nur auf Tiefe 0 verändert eine Ersetzung die
+	 * Größe des Dokuments.
+	 */
+	std::vector<SourceLine> simplify_macro_spec_impl(
+		const std::vector<SourceLine>& text,
+		const macro_spec& spec,
+		const FormatProgram& program,
+		PreprocReport& report,
+		ExpansionCache* cache,
+		ExpansionBudget& budget,
+		size_t depth,
+		std::vector<LineFeatures>* features)
+	{
+		size_t macro_pos = 0;   // Aktuelle Suchposition innerhalb der Zeile
+		size_t end_pos = 0;   // Endposition des vollständigen Makroausdrucks
+
+
+		std::vector<SourceLine> result = text;
+		const std::string call_start = spec.name + '{';
+		const bool needs_backslash = !spec.name.empty() && spec.name[0] == '\\';
+
+		fit_line_features(features, result.size());
+		for (size_t i = 0; i < result.size(); i++) {
+			SourceLine& sl = result[i];
+
+			// Ohne '{' (bzw. '\\') kann die Zeile keinen Aufruf enthalten
+			LineFeatures line_features = line_features_at(features, i, sl);
+			if (!line_features.has(kLineBrace) || (needs_backslash && !line_features.has(kLineBackslash))) {
+				continue;
+			}
+
+			macro_pos = 0;
+			if (depth == 0) {
+				budget.begin_line();
+			}
+
+			// Die Zeile wird von links nach rechts in expanded neu aufgebaut statt
+			// an Ort und Stelle ersetzt, damit viele Aufrufe in einer (z. B. aus
+			// mehreren Zeilen zusammengefügten) Zeile nicht quadratisch werden.
+			// Suchpositionen beziehen sich auf die unveränderte sl.line.
+			std::string expanded;
+			size_t copied = 0;   // Ende des nach expanded übernommenen Teils von sl.line
+			auto current_size = [&] { return expanded.size() + sl.line.size() - copied; };
+			auto finish_line = [&] {
+				if (copied > 0) {
+					expanded.append(sl.line, copied, std::string::npos);
+					sl.line.swap(expanded);
+					if (features) {
+						(*features)[i] = LineFeatures{};
+					}
+				}
+			};
+
+			// Suche nach Vorkommen des Makros (z. B. "\frac{...}")
+			while ((macro_pos = sl.line.find(call_start, macro_pos)) != std::string::npos) {
+
+				// Dokumentlimit oder Zeitlimit erreicht → Rest unverändert lassen
+				if (budget.exhausted() || !budget.check_deadline(sl, report)) {
+					finish_line();
+					return result;
+				}
+
+				// Zeilenlimit überschritten → Rest der Zeile unverändert lassen
+				if (budget.line_exceeded()) {
+					break;
+				}
+
+				// Argumente aus dem Makro extrahieren
+				end_pos = 0;
+				std::vector<std::string> args =
+					extract_math_args(
+						sl.line,
+						macro_pos + spec.name.size(),
+						end_pos
+					);
+
+				// Nach erstem Argument
+				if (end_pos + 1 < sl.line.size() && sl.line[end_pos + 1] == '{') {
+					// vermutlich echtes LaTeX \frac{a}{b}
+					macro_pos += spec.name.size();
+					continue;
+				}
+
+				// Fehlerfall: falsche Anzahl an Argumenten
+				if (args.size() != spec.arg_count) {
+					report.errors.push_back({
+						sl.file,
+						"Fehler bei '" + spec.name +
+						"': erwartet " + std::to_string(spec.arg_count) +
+						" Argument(e), aber " + std::to_string(args.size()) +
+						" gefunden.",
+						sl.line_nr
+						});
+
+					// Weitersuchen hinter dem Makronamen, um Endlosschleifen zu vermeiden
+					macro_pos += spec.name.size();
+					continue;
+				}
+
+				// Zu tief verschachtelt → Aufruf unverändert lassen
+				if (!budget.allow_depth(depth, sl, spec.name, report)) {
+					macro_pos += spec.name.size();
+					continue;
+				}
+
+				// Bereits expandierter identischer Aufruf?
+				size_t args_pos = macro_pos + spec.name.size();
+				std::string cache_key;
+				const std::string* cached = nullptr;
+				if (cache) {
+					cache_key = ExpansionCache::make_key(
+						spec.name, sl.line.substr(args_pos, end_pos - args_pos + 1));
+					cached = cache->find(cache_key);
+				}
+
+				size_t call_size = end_pos - macro_pos + 1;
+				std::string replacement;
+				if (cached) {
+					replacement = *cached;
+				}
+				else {
+					size_t errors_before = report.errors.size();
+
+					// Rekursive Verarbeitung der Argumente (falls diese selbst Makros enthalten)
+					for (std::string& arg : args) {
+						if (arg.find(call_start) == std::string::npos) {
+							continue;
+						}
+						std::vector<SourceLine> tmp;
+						tmp.push_back({
+							arg,
+							sl.file,
+							sl.line_nr
+							});
+
+						tmp = simplify_macro_spec_impl(tmp, spec, program, report, cache, budget, depth + 1, nullptr);
+						arg = tmp[0].line;
+					}
+
+					// Abbruch in der Rekursion → Aufruf mit halb expandierten Argumenten nicht ersetzen
+					if (budget.exhausted()) {
+						finish_line();
+						return result;
+					}
+					if (budget.line_exceeded()) {
+						break;
+					}
+
+					// Übergroße Expansion gar nicht erst aufbauen
+					size_t line_size = current_size() - call_size + program.output_size(args);
+					if (!budget.allow_line(line_size, sl, spec.name, report)) {
+						break;
+					}
+
+					replacement = program.run(args);
+
+					// Nur fehlerfreie Expansionen merken, damit Fehler
+					// bei jedem Vorkommen gemeldet werden
+					if (cache && report.errors.size() == errors_before) {
+						cache->insert(cache_key, replacement);
+					}
+				}
+
+				if (cached && !budget.allow_line(current_size() - call_size + replacement.size(), sl, spec.name, report)) {
+					break;
+				}
+
+				if (depth == 0 && !budget.add_document_bytes(
+					static_cast<int64_t>(replacement.size()) - static_cast<int64_t>(call_size), sl, report)) {
+					finish_line();
+					return result;
+				}
+
+				// Ersetzung des Makroaufrufs durch den formatierten LaTeX-Ausdruck
+				expanded.append(sl.line, copied, macro_pos - copied);
+				expanded += replacement;
+
+				// Suchposition hinter den ersetzten Aufruf verschieben
+				macro_pos += call_size;
+				copied = macro_pos;
+			}
+			finish_line();
+		}
+		return result;
+	}
+
+} // anonymer Namespace
+
+
 /**
  * Vereinfacht rekursiv ein bestimmtes Formatmakro im Text anhand
  * der übergebenen Makrospezifikation.
@@ -120,86 +308,248 @@ std::string apply_format(const std::string& replacement, const std::vector<std::
  *              (enthält Zeilentext, Dateiname und Zeilennummer).
  *     spec   – Makrospezifikation (Name, Argumentanzahl, Ersetzungsregel).
  *     report – Fehlerbericht zur Sammlung von Syntax- und Verarbeitungsfehlern.
+ *     cache  – Optionaler Expansions-Cache; identische Aufrufe werden
+ *              nur einmal expandiert (nullptr = kein Cache).
+ *     budget – Optionale Ressourcenlimits (nullptr = Standardlimits
+ *              nur für diesen Aufruf).
+ *     features – Optionale Zeilenmerkmale zu text (line_features.h),
+ *              danach passend zum Ergebnis.
  *
  * Rückgabe:
  *     Neuer Vektor von SourceLine-Objekten mit ersetzten Makros.
- */std::vector<SourceLine> simplify_macro_spec(
-	 const std::vector<SourceLine>& text,
-	 const macro_spec& spec,
-	 PreprocReport& report)
- {
-	 size_t macro_pos = 0;   // Aktuelle Suchposition innerhalb der Zeile
-	 size_t end_pos = 0;   // Endposition des vollständigen Makroausdrucks
-
-
-	 std::vector<SourceLine> result = text;
-
-	 for (SourceLine& sl : result) {
-
-		 macro_pos = 0;
-
-		 // Suche nach Vorkommen des Makros (z. B. "\frac{...}")
-		 while ((macro_pos = sl.line.find(spec.name + '{', macro_pos)) != std::string::npos) {
-
-
-
-			 // Argumente aus dem Makro extrahieren
-			 end_pos = 0;
-			 std::vector<std::string> args =
-				 extract_math_args(
-					 sl.line,
-					 macro_pos + spec.name.size(),
-					 end_pos
-				 );
-
-			 // Nach erstem Argument
-			 if (end_pos + 1 < sl.line.size() && sl.line[end_pos + 1] == '{') {
-				 // vermutlich echtes LaTeX \frac{a}{b}
-				 macro_pos += spec.name.size();
-				 continue;
-			 }
-
-			 // Fehlerfall: falsche Anzahl an Argumenten
-			 if (args.size() != spec.arg_count) {
-				 report.errors.push_back({
-					 sl.file,
-					 "Fehler bei '" + spec.name +
-					 "': erwartet " + std::to_string(spec.arg_count) +
-					 " Argument(e), aber " + std::to_string(args.size()) +
-					 " gefunden.",
-					 sl.line_nr
-					 });
-
-				 // Weitersuchen hinter dem Makronamen, um Endlosschleifen zu vermeiden
-				 macro_pos += spec.name.size();
-				 continue;
-			 }
-
-			 // Rekursive Verarbeitung der Argumente (falls diese selbst Makros enthalten)
-			 for (std::string& arg : args) {
-				 std::vector<SourceLine> tmp;
-				 tmp.push_back({
-					 arg,
-					 sl.file,
-					 sl.line_nr
-					 });
-
-				 tmp = simplify_macro_spec(tmp, spec, report);
-				 arg = tmp[0].line;
-			 }
-
-			 // Ersetzung des Makroaufrufs durch den formatierten LaTeX-Ausdruck
-			 std::string replacement = apply_format(spec.replacement, args);
-			 sl.line.replace(
-				 macro_pos,
-				 end_pos - macro_pos + 1,
-				 replacement
-			 );
-
-			 // Suchposition hinter das ersetzte Makro verschieben
-			 macro_pos += replacement.size();
-		 }
-	 }
-	return result;
- }
+ */
+std::vector<SourceLine> simplify_macro_spec(
+	const std::vector<SourceLine>& text,
+	const macro_spec& spec,
+	PreprocReport& report,
+	ExpansionCache* cache,
+	ExpansionBudget* budget,
+	std::vector<LineFeatures>* features)
+{
+	// Übersetzt wird einmal beim Laden (dynamic_macro::program), sonst hier
+	FormatProgram local_program;
+	const FormatProgram* program = spec.program;
+	if (!program || !program->compiled()) {
+		local_program = FormatProgram::compile(spec.replacement, spec.arg_count);
+		program = &local_program;
+	}
+
+	if (!budget) {
+		ExpansionBudget local_budget;
+		return simplify_macro_spec_impl(text, spec, *program, report, cache, local_budget, 0, features);
+	}
+	return simplify_macro_spec_impl(text, spec, *program, report, cache, *budget, 0, features);
+}
+
+
+/**
+ * Ein Steuerwort beginnt an jedem Backslash; auch in "\\log" wird
+ * "\log" erfasst, da simplify_macro_spec() dort ebenfalls "\log{" findet.
+ * Ein einzelner Backslash ohne Buchstaben wird als "\\" geführt.
+ */
+void collect_control_words(std::string_view text, std::unordered_set<std::string>& words) {
+	for (size_t pos = text.find('\\'); pos != std::string_view::npos; pos = text.find('\\', pos + 1)) {
+		size_t end = pos + 1;
+		while (end < text.size() && std::isalpha(static_cast<unsigned char>(text[end]))) {
+			end++;
+		}
+		words.emplace(text.substr(pos, end - pos));
+	}
+}
+
+
+std::unordered_set<std::string> collect_control_words(const std::vector<SourceLine>& text) {
+	std::unordered_set<std::string> words;
+	for (const SourceLine& sl : text) {
+		collect_control_words(sl.line, words);
+	}
+	return words;
+}
+
+
+/**
+ * Neue Steuerwörter entstehen nur an den Nahtstellen einer Ersetzung:
+ *   - am Anfang: Buchstaben oder ein Argument hinter einem "\fr" davor
+ *   - am Ende:   "\fr" oder ein Argument vor Buchstaben dahinter
+ *   - an Platzhaltern: "\fr__0__" bzw. "__0__ac"
+ *   - eine leere Ersetzung fügt beide Seiten zusammen: "\fr\foo{}ac"
+ * Die Prüfung ist konservativ; Formatstrings wie "\frac{__0__}{__1__}"
+ * sind unbedenklich.
+ */
+bool may_form_control_words(const std::string& replacement) {
+
+	auto is_letter = [](char c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; };
+
+	// Endet replacement[0, pos) mit einem (evtl. leeren) Steuerwort?
+	auto ends_in_control_word = [&](size_t pos) {
+		while (pos > 0 && is_letter(replacement[pos - 1])) {
+			pos--;
+		}
+		return pos > 0 && replacement[pos - 1] == '\\';
+	};
+
+	if (replacement.empty()) {
+		return true;
+	}
+	if (is_letter(replacement.front()) || ends_in_control_word(replacement.size())) {
+		return true;
+	}
+
+	for (size_t pos = replacement.find("__"); pos != std::string::npos; pos = replacement.find("__", pos + 1)) {
+		size_t digits = pos + 2;
+		while (digits < replacement.size() && std::isdigit(static_cast<unsigned char>(replacement[digits]))) {
+			digits++;
+		}
+		if (digits == pos + 2 || replacement.compare(digits, 2, "__") != 0) {
+			continue;
+		}
+		size_t end = digits + 2;
+		if (pos == 0 || end == replacement.size() || ends_in_control_word(pos) || is_letter(replacement[end])) {
+			return true;
+		}
+		pos = end - 1;
+	}
+	return false;
+}
+
+
+/**
+ * Zählt die Klammern ab open wie extract_math_args(), läuft dabei aber
+ * über das Zeilenende hinaus in die folgenden Zeilen, als lägen alle
+ * Zeilen hintereinander in einem Puffer. Eine Leerzeile (nur Leerraum)
+ * beendet die Suche, sodass eine vergessene Klammer nicht den Rest des
+ * Dokuments durchläuft.
+ */
+std::optional<LinePosition> find_closing_brace(const std::vector<SourceLine>& text, LinePosition open) {
+
+	size_t depth = 0;
+	for (size_t l = open.line; l < text.size(); l++) {
+		const std::string& line = text[l].line;
+		if (l > open.line && line.find_first_not_of(" \t\r") == std::string::npos) {
+			return std::nullopt;
+		}
+		for (size_t c = (l == open.line ? open.column : 0); c < line.size(); c++) {
+			if (line[c] == '{') {
+				depth++;
+			}
+			else if (line[c] == '}' && depth > 0 && --depth == 0) {
+				return LinePosition{ l, c };
+			}
+		}
+	}
+	return std::nullopt;
+}
+
+
+namespace {
+
+	// true, wenn in line eine '{' nicht innerhalb der Zeile geschlossen wird.
+	bool has_unclosed_brace(const std::string& line) {
+		size_t depth = 0;
+		for (char c : line) {
+			if (c == '{') {
+				depth++;
+			}
+			else if (c == '}' && depth > 0) {
+				depth--;
+			}
+		}
+		return depth > 0;
+	}
 
+} // anonymer Namespace
+
+
+/**
+ * Nur Zeilen mit einer offenen Klammer werden näher untersucht. Reicht ein
+ * dort beginnender Aufruf in eine spätere Zeile, werden alle Zeilen bis zu
+ * seiner schließenden Klammer verbunden; Aufrufe, die in diesen Zeilen
+ * beginnen und noch weiter reichen, verlängern den Bereich.
+ */
+std::vector<SourceLine> join_multiline_calls(std::vector<SourceLine> text,
+	const std::vector<std::string>& names,
+	std::vector<JoinedLine>& joined)
+{
+	joined.clear();
+
+	std::vector<SourceLine> result;
+	bool copying = false;   // result erst ab dem ersten Zusammenfügen aufbauen
+
+	for (size_t i = 0; i < text.size(); i++) {
+
+		size_t last = i;
+		if (has_unclosed_brace(text[i].line)) {
+			for (size_t l = i; l <= last; l++) {
+				const std::string& line = text[l].line;
+				for (const std::string& name : names) {
+					for (size_t pos = line.find(name + '{'); pos != std::string::npos; pos = line.find(name + '{', pos + 1)) {
+						std::optional<LinePosition> close = find_closing_brace(text, { l, pos + name.size() });
+						if (close && close->line > last) {
+							last = close->line;
+						}
+					}
+				}
+			}
+		}
+
+		if (last == i) {
+			if (copying) {
+				result.push_back(std::move(text[i]));
+			}
+			continue;
+		}
+
+		if (!copying) {
+			result.reserve(text.size());
+			std::move(text.begin(), text.begin() + i, std::back_inserter(result));
+			copying = true;
+		}
+
+		JoinedLine origin{ result.size(), {} };
+		SourceLine merged{ std::move(text[i].line), text[i].file, text[i].line_nr };
+		origin.parts.push_back({ "", text[i].file, text[i].line_nr });
+		for (size_t l = i + 1; l <= last; l++) {
+			merged.line += '\n';
+			merged.line += text[l].line;
+			origin.parts.push_back({ "", text[l].file, text[l].line_nr });
+		}
+		result.push_back(std::move(merged));
+		joined.push_back(std::move(origin));
+		i = last;
+	}
+
+	return copying ? result : text;
+}
+
+
+std::vector<SourceLine> split_joined_lines(std::vector<SourceLine> text, const std::vector<JoinedLine>& joined) {
+
+	if (joined.empty()) {
+		return text;
+	}
+
+	std::vector<SourceLine> result;
+	result.reserve(text.size() + joined.size());
+
+	size_t next = 0;   // nächster Eintrag in joined
+	for (size_t i = 0; i < text.size(); i++) {
+		if (next == joined.size() || joined[next].index != i) {
+			result.push_back(std::move(text[i]));
+			continue;
+		}
+
+		const std::vector<SourceLine>& parts = joined[next++].parts;
+		const std::string& line = text[i].line;
+		size_t start = 0;
+		for (size_t j = 0;; j++) {
+			size_t end = line.find('\n', start);
+			const SourceLine& origin = parts[std::min(j, parts.size() - 1)];
+			result.push_back({ line.substr(start, end - start), origin.file, origin.line_nr });
+			if (end == std::string::npos) {
+				break;
+			}
+			start = end + 1;
+		}
+	}
+	return result;
+}
@@ -6,17 +6,31 @@
 // ------------------------------
 
 
+#include "latexprepro.h"
 #include "preprocessor.h"
 #include "file_utils.h"
 #include "cli_utils.h"
 #include "macro_handler.h"
 #include "error_collector.h"
 #include "source_line.h"
+#include "pipeline_stats.h"
+#include "alloc_stats.h"
+#include "trace.h"
+#include "file_watcher.h"
+#include "expansion_cache.h"
+#include "line_cache.h"
 
+#ifdef LATEXPREPRO_BUILTIN_MACROS
+#include "macro_codegen.h"
+#endif
 
+
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <unordered_map>
 #include <string>
+#include <utility>
 
 
 //#define DEBUG_MODE             
@@ -30,75 +44,312 @@ void log_step(const std::string& title, const std::string& content) {
 }
 
 
+/**
+ * Gibt die gesammelten Laufzeiten aus (--timings) und schreibt
+ * die aufgezeichneten Trace-Events (--trace).
+ */
+void write_run_reports(const CliConfig& config, const PipelineStats& stats) {
+    if (config.timings == "json") {
+        std::cout << stats_to_json(stats) << "\n";
+    }
+    else if (config.timings == "table") {
+        print_stats_table(std::cout, stats);
+    }
+
+    if (!config.trace_file.empty()) {
+        write_trace(config.trace_file);
+    }
+}
+
+
 
 /**
- * Führt den LaTeX-Präprozessor mit den übergebenen Kommandozeilenargumenten aus.
+ * Zustand, der zwischen mehreren Läufen erhalten bleibt (--watch).
+ *
+ * Bei einem einzelnen Lauf wird die Session genau einmal verwendet.
+ */
+struct Session {
+    MacroLibrary macros;              // instanziiert wird je Lauf nur, was das Dokument nutzt
+    bool macros_loaded = false;
+    uint64_t macro_hash = 0;
+
+    FileCache file_cache;             // Include-Dateien des letzten Laufs
+    std::vector<std::string> missing_includes;   // nicht lesbare Includes des letzten Laufs
+    ExpansionCache expansion_cache;   // Expansionen identischer Aufrufe
+    LineCache line_cache;             // expandierte Zeilen (ggf. persistent)
+};
+
+
+/**
+ * Gibt die gesammelten Fehler auf stderr aus.
+ */
+void print_errors(const PreprocReport& report) {
+    std::cerr << "Es sind Fehler aufgetreten:\n";
+    for (auto& e : report.errors) {
+        std::cerr << "[Fehler] in " << e.file << " - ";
+        if (e.line > 0) {
+            std::cerr << "Zeile " << e.line;
+        }
+        std::cerr << ": " << e.message << "\n";
+    }
+}
+
+
+/**
+ * Führt einen vollständigen Präprozessor-Lauf aus.
  *
  * Ablauf:
- *   1. Parsen der CLI-Argumente
- *   2. Einlesen der Eingabedatei
- *   3. Laden der Makrodefinitionen (JSON)
+ *   1. Einlesen der Eingabedatei
+ *   2. Laden der Makrodatei (JSON) bzw. der eingebauten Makros, sofern nicht bereits geladen
+ *   3. Auflösen der \include-Anweisungen
  *   4. Extraktion von \define-Makros
- *   5. Anwendung aller dynamischen Makros
+ *   5. Instanziieren und Anwenden der im Dokument verwendeten Makros
  *   6. Ausgabe in die Zieldatei
  *
  * Rückgabewerte:
  *   0  – Verarbeitung erfolgreich
- *   1  – Fehler
+ *  -1  – Fehler
  */
-int run_preprocessor(int argc, char* argv[]) {
-
-    auto configOpt = parse_cli_args(argc, argv);
-    if (!configOpt) {
-        return -1;
-    }
-
-    CliConfig config = *configOpt;
+int process_document(const CliConfig& config, Session& session) {
 
-    std::cout << "Eingabedatei: " << config.input_file  << "\n"
-              << "Ausgabedatei: " << config.output_file << "\n"
-              << "Makro-Datei: "  << config.macro_file  << "\n";
+    PreprocReport report;
+    report.stats.enabled = !config.timings.empty();
 
-    std::vector<SourceLine> content = read_file_lines(config.input_file);
+    std::vector<SourceLine> content;
+    {
+        StageTimer timer(report.stats, "read_file_lines");
+        content = read_file_lines(config.input_file);
+        timer.set_output(content);
+    }
     //std::string content = read_file(config.input_file);
     if (content.empty()) {
         return -1;  
     }
-
-    PreprocReport report;
    
 
     // Makros aus JSON laden
-    std::unordered_map<std::string, dynamic_macro> all_macros = load_all_macros(config.macro_file, report);
+    if (!session.macros_loaded) {
+        StageTimer timer(report.stats, "load_macro_library");
+#ifdef LATEXPREPRO_BUILTIN_MACROS
+        session.macros = builtin_macro_library();   // zur Build-Zeit erzeugt, --macros wird ignoriert
+#else
+        session.macros = MacroLibrary::load(config.macro_file, report);
+#endif
+        session.macros_loaded = true;
 
+        // Neue Makrosammlung → zwischengespeicherte Expansionen ungültig
+        uint64_t macro_hash = session.macros.hash();
+        if (macro_hash != session.macro_hash) {
+            session.macro_hash = macro_hash;
+            session.expansion_cache = ExpansionCache();
+            if (!config.cache_dir.empty()) {
+                session.line_cache.load(config.cache_dir, macro_hash);
+            }
+            else {
+                session.line_cache.clear();
+            }
+        }
+    }
+    const MacroLibrary& all_macros = session.macros;
 
-    std::unordered_set<std::string> include_stack;
-    content = process_include(content, report, include_stack);
 
+    // Includes, Defines und Makros (Kernbibliothek, Zeilen-Cache nur mit --cache-dir oder --watch)
+    PreprocOptions options;
+    options.include_options.file_cache = &session.file_cache;
+    options.include_options.jobs = config.jobs;
+    options.include_options.search_paths = config.include_dirs;
+    options.include_options.batch_read = config.batch_read;
+    options.include_options.missing_files = &session.missing_includes;
+    options.macro_options.expansion_cache = &session.expansion_cache;
+    options.macro_options.limits = config.limits;
+    if (!config.cache_dir.empty() || config.watch) {
+        options.macro_options.line_cache = &session.line_cache;
+    }
+    content = preprocess_lines(std::move(content), all_macros, report, options);
 
-    // \define-Makros aus dem Text extrahieren
-    std::unordered_map<std::string, std::string> define_macros = extract_defines(content, report);
+    // Fehlerbericht auswerten
+    if (report.has_errors()) {
+        print_errors(report);
+        write_run_reports(config, report.stats);
+        return -1; // Verarbeitung abbrechen
 
-     
-    // Alle Makros anwenden
-    content = apply_all_macros(content, all_macros, define_macros, report);
+    }
+    {
+        StageTimer timer(report.stats, "save_to_file", &content);
+        SourceMap source_map;
+        SaveResult saved = save_to_file(config.output_file, content,
+            config.source_map ? &source_map : nullptr);
+        report.stats.output_unchanged = (saved == SaveResult::Unchanged);
+        if (saved == SaveResult::Failed) {
+            return -1;
+        }
+
+        // Source-Map neben der Ausgabe ablegen (<ausgabe>.map)
+        if (config.source_map) {
+            source_map.write(config.output_file + ".map");
+        }
+    }
+
+    if (session.line_cache.is_open()) {
+        session.line_cache.save();
+    }
+    session.line_cache.trim();
+
+    write_run_reports(config, report.stats);
+    return 0;
+}
+
+
+/**
+ * Abhängigkeitsmodus (-M/--MF): schreibt eine make-Regel
+ *
+ *   <ausgabe>: <eingabe> <alle eingebundenen Dateien> <makrodatei>
+ *
+ * (ohne Makrodatei in der Variante mit eingebauten Makros)
+ *
+ * Es wird nur der \include-Graph durchlaufen; Defines, Bedingungen und
+ * Formatmakros werden nicht ausgewertet, die Makrodatei nicht geladen.
+ * --timings und --trace gelten wie bei der Verarbeitung.
+ *
+ * Rückgabewerte:
+ *   0  – Abhängigkeiten geschrieben
+ *  -1  – Fehler (z. B. fehlende Include-Datei)
+ */
+int write_dependencies(const CliConfig& config) {
+
+    PreprocReport report;
+    report.stats.enabled = !config.timings.empty();
+
+    std::vector<SourceLine> content;
+    {
+        StageTimer timer(report.stats, "read_file_lines");
+        content = read_file_lines(config.input_file);
+        timer.set_output(content);
+    }
+    if (content.empty()) {
+        write_run_reports(config, report.stats);
+        return -1;
+    }
+
+    IncludeOptions options;
+    options.jobs = config.jobs;
+    options.search_paths = config.include_dirs;
+    options.batch_read = config.batch_read;
+
+    std::vector<std::string> prerequisites{ config.input_file };
+    {
+        StageTimer timer(report.stats, "collect_include_dependencies");
+        for (std::string& dependency : collect_include_dependencies(content, report, options)) {
+            prerequisites.push_back(std::move(dependency));
+        }
+    }
+#ifndef LATEXPREPRO_BUILTIN_MACROS
+    if (disk_file_provider().exists(config.macro_file)) {
+        prerequisites.push_back(config.macro_file);
+    }
+#endif
 
-    // Fehlerbericht auswerten
     if (report.has_errors()) {
-        std::cerr << "Es sind Fehler aufgetreten:\n";
-        for (auto& e : report.errors) {
-            std::cerr << "[Fehler] in " << e.file << " - ";
-            if (e.line > 0) {
-                std::cerr << "Zeile " << e.line;
+        print_errors(report);
+        write_run_reports(config, report.stats);
+        return -1;
+    }
+    bool written = write_dependency_file(config.dependency_file, config.output_file, prerequisites);
+    write_run_reports(config, report.stats);
+    return written ? 0 : -1;
+}
+
+
+/**
+ * Watch-Modus: Überwacht Eingabedatei, alle eingebundenen Dateien, die
+ * Pfade fehlender Includes und die Makrodatei und verarbeitet das Dokument
+ * bei jeder Änderung neu.
+ *
+ * Unveränderte Include-Dateien werden nicht erneut gelesen, und Zeilen,
+ * deren Text sich nicht geändert hat, kommen aus dem Zeilen-Cache.
+ * Die Funktion kehrt nur bei fehlender inotify-Unterstützung zurück.
+ */
+int watch_document(const CliConfig& config, Session& session) {
+
+    FileWatcher watcher;
+    if (!watcher.available()) {
+        std::cerr << "+++ Fehler: --watch wird auf dieser Plattform nicht unterstützt +++\n";
+        return -1;
+    }
+
+    for (;;) {
+        std::vector<std::string> files{ config.input_file, config.macro_file };
+        for (const auto& [filename, lines] : session.file_cache) {
+            files.push_back(filename);
+        }
+        // Fehlende Includes: das Anlegen der Datei löst ebenfalls einen Lauf aus
+        files.insert(files.end(), session.missing_includes.begin(), session.missing_includes.end());
+        watcher.watch(files);
+
+        std::cout << "Warte auf Änderungen...\n";
+        std::vector<std::string> changed = watcher.wait_for_changes();
+        if (changed.empty()) {
+            continue;
+        }
+
+        for (const std::string& file : changed) {
+            std::cout << "Geändert: " << file << "\n";
+            if (file == config.macro_file) {
+                session.macros_loaded = false;
             }
-            std::cerr << ": " << e.message << "\n";
+            session.file_cache.erase(file);
         }
-        return -1; // Verarbeitung abbrechen
 
+        auto start = std::chrono::steady_clock::now();
+        process_document(config, session);
+        auto elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "Neu verarbeitet in " << elapsed << " ms\n";
     }
-    save_to_file(config.output_file, content);
+}
 
-    return 0;
+
+/**
+ * Führt den LaTeX-Präprozessor mit den übergebenen Kommandozeilenargumenten aus.
+ *
+ * Rückgabewerte:
+ *   0  – Verarbeitung erfolgreich
+ *  -1  – Fehler
+ */
+int run_preprocessor(int argc, char* argv[]) {
+
+    auto configOpt = parse_cli_args(argc, argv);
+    if (!configOpt) {
+        return -1;
+    }
+
+    CliConfig config = *configOpt;
+
+    std::cout << "Eingabedatei: " << config.input_file  << "\n"
+              << "Ausgabedatei: " << config.output_file << "\n"
+              << "Makro-Datei: "  << config.macro_file  << "\n";
+
+    // Instrumentierte Builds melden Speicherwerte immer
+    if (alloc_stats_enabled() && config.timings.empty()) {
+        config.timings = "table";
+    }
+
+    if (!config.trace_file.empty()) {
+        trace_enable();
+        trace_set_thread_name("main");
+    }
+
+    if (config.dependencies) {
+        return write_dependencies(config);
+    }
+
+    Session session;
+    int result = process_document(config, session);
+
+    if (!config.watch) {
+        return result;
+    }
+    return watch_document(config, session);
 
 }
 int main(int argc, char* argv[]) {
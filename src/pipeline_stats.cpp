@@ -0,0 +1,226 @@
+#include "pipeline_stats.h"
+#include "json.hpp"
+
+#include <iomanip>
+
+
+namespace {
+
+    /**
+     * Zählt Zeilen und Bytes eines Textes.
+     * Jede Zeile zählt inklusive ihres Zeilenumbruchs, entsprechend
+     * der späteren Ausgabe durch save_to_file().
+     */
+    void count_lines(const std::vector<SourceLine>& lines, size_t& line_count, size_t& byte_count) {
+        line_count = lines.size();
+        byte_count = 0;
+        for (const SourceLine& sl : lines) {
+            byte_count += sl.line.size() + 1;
+        }
+    }
+
+
+    /**
+     * Gibt die Trefferzähler eines Caches aus, sofern er benutzt wurde.
+     */
+    void print_cache_stats(std::ostream& out, const char* label, const CacheStats& cache) {
+        if (cache.hits + cache.misses == 0) {
+            return;
+        }
+        out << label << ": " << cache.hits << " Treffer, "
+            << cache.misses << " Fehlversuche, " << cache.evictions << " verdrängt ("
+            << std::fixed << std::setprecision(1) << cache.hit_rate() * 100.0 << " % Trefferquote)\n";
+    }
+
+    nlohmann::json cache_stats_to_json(const CacheStats& cache) {
+        return {
+            { "hits", cache.hits },
+            { "misses", cache.misses },
+            { "evictions", cache.evictions },
+            { "hit_rate", cache.hit_rate() }
+        };
+    }
+
+} // anonymer Namespace
+
+
+StageTimer::StageTimer(PipelineStats& stats, const std::string& name,
+    const std::vector<SourceLine>* input)
+    : stats_(stats)
+    , trace_("stage", name)
+{
+    if (!stats_.enabled) {
+        return;
+    }
+
+    // Eintrag sofort anlegen, damit äußere Schritte vor inneren erscheinen
+    StageStats entry;
+    entry.name = name;
+    entry.depth = stats_.depth++;
+    if (input) {
+        count_lines(*input, entry.in_lines, entry.in_bytes);
+    }
+
+    index_ = stats_.stages.size();
+    stats_.stages.push_back(entry);
+
+    // Erst nach dem Anlegen des Eintrags messen, damit dessen
+    // eigene Allokationen nicht dem Schritt zugerechnet werden
+    if constexpr (alloc_stats_enabled()) {
+        saved_peak_ = alloc_begin_scope();
+        alloc_start_ = alloc_snapshot();
+    }
+    start_ = std::chrono::steady_clock::now();
+}
+
+
+StageTimer::~StageTimer() {
+    if (!stats_.enabled) {
+        return;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    StageStats& entry = stats_.stages[index_];
+    entry.wall_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+
+    if constexpr (alloc_stats_enabled()) {
+        AllocSnapshot end = alloc_snapshot();
+        entry.allocations = end.allocations - alloc_start_.allocations;
+        entry.alloc_bytes = end.bytes - alloc_start_.bytes;
+        entry.peak_live = alloc_end_scope(saved_peak_);
+    }
+    stats_.depth--;
+}
+
+
+void StageTimer::set_output(const std::vector<SourceLine>& output) {
+    if (!stats_.enabled) {
+        return;
+    }
+    StageStats& entry = stats_.stages[index_];
+    count_lines(output, entry.out_lines, entry.out_bytes);
+}
+
+
+/**
+ * Gibt die Messwerte als eingerückte Tabelle aus.
+ *
+ * Unterschritte (z. B. einzelne Formatmakros innerhalb von
+ * apply_all_macros) werden entsprechend ihrer Tiefe eingerückt.
+ * Die Summenzeile berücksichtigt nur Hauptschritte.
+ */
+void print_stats_table(std::ostream& out, const PipelineStats& stats) {
+
+    double total_ms = 0.0;
+
+    out << "\n### Laufzeiten ###\n"
+        << std::left << std::setw(34) << "Schritt"
+        << std::right
+        << std::setw(12) << "Zeit [ms]"
+        << std::setw(12) << "Zeilen ein"
+        << std::setw(12) << "Bytes ein"
+        << std::setw(12) << "Zeilen aus"
+        << std::setw(12) << "Bytes aus"
+        << std::setw(12) << "MB/s";
+    if constexpr (alloc_stats_enabled()) {
+        out << std::setw(12) << "Allok."
+            << std::setw(14) << "Allok. Bytes"
+            << std::setw(14) << "Peak live";
+    }
+    out << "\n";
+
+    for (const StageStats& s : stats.stages) {
+
+        if (s.depth == 0) {
+            total_ms += s.wall_ms;
+        }
+
+        // Durchsatz bezogen auf die Eingabemenge
+        double mb_per_s = s.wall_ms > 0.0
+            ? (static_cast<double>(s.in_bytes) / (1024.0 * 1024.0)) / (s.wall_ms / 1000.0)
+            : 0.0;
+
+        out << std::left << std::setw(34) << (std::string(2 * s.depth, ' ') + s.name)
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << s.wall_ms
+            << std::setw(12) << s.in_lines
+            << std::setw(12) << s.in_bytes
+            << std::setw(12) << s.out_lines
+            << std::setw(12) << s.out_bytes
+            << std::setprecision(1)
+            << std::setw(12) << mb_per_s;
+        if constexpr (alloc_stats_enabled()) {
+            out << std::setw(12) << s.allocations
+                << std::setw(14) << s.alloc_bytes
+                << std::setw(14) << s.peak_live;
+        }
+        out << "\n";
+    }
+
+    out << std::left << std::setw(34) << "Gesamt"
+        << std::right << std::fixed << std::setprecision(3)
+        << std::setw(12) << total_ms << "\n";
+
+    print_cache_stats(out, "Expansions-Cache", stats.expansion_cache);
+    print_cache_stats(out, "Zeilen-Cache", stats.line_cache);
+
+    if (stats.output_unchanged) {
+        out << "Ausgabe unverändert: Datei wurde nicht neu geschrieben\n";
+    }
+
+    if constexpr (alloc_stats_enabled()) {
+        AllocSnapshot total = alloc_snapshot();
+        out << "Allokationen gesamt: " << total.allocations
+            << " (" << total.bytes << " Bytes), Peak live: " << alloc_peak_bytes()
+            << " Bytes, Peak RSS: " << peak_rss_bytes() << " Bytes\n";
+    }
+}
+
+
+/**
+ * Serialisiert die Messwerte als JSON-Text, z. B.
+ *   {"stages":[{"name":"process_include","depth":0,"wall_ms":0.41,...}],
+ *    "total_ms":1.2}
+ */
+std::string stats_to_json(const PipelineStats& stats) {
+
+    nlohmann::json stages = nlohmann::json::array();
+    double total_ms = 0.0;
+
+    for (const StageStats& s : stats.stages) {
+        if (s.depth == 0) {
+            total_ms += s.wall_ms;
+        }
+        nlohmann::json stage = {
+            { "name", s.name },
+            { "depth", s.depth },
+            { "wall_ms", s.wall_ms },
+            { "in_lines", s.in_lines },
+            { "in_bytes", s.in_bytes },
+            { "out_lines", s.out_lines },
+            { "out_bytes", s.out_bytes }
+        };
+        if constexpr (alloc_stats_enabled()) {
+            stage["allocations"] = s.allocations;
+            stage["alloc_bytes"] = s.alloc_bytes;
+            stage["peak_live_bytes"] = s.peak_live;
+        }
+        stages.push_back(stage);
+    }
+
+    nlohmann::json result = {
+        { "stages", stages },
+        { "total_ms", total_ms },
+        { "expansion_cache", cache_stats_to_json(stats.expansion_cache) },
+        { "line_cache", cache_stats_to_json(stats.line_cache) },
+        { "output_unchanged", stats.output_unchanged }
+    };
+    if constexpr (alloc_stats_enabled()) {
+        AllocSnapshot total = alloc_snapshot();
+        result["allocations"] = total.allocations;
+        result["alloc_bytes"] = total.bytes;
+        result["peak_live_bytes"] = alloc_peak_bytes();
+        result["peak_rss_bytes"] = peak_rss_bytes();
+    }
+    return result.dump(2);
+}
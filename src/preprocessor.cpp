@@ -1,12 +1,662 @@
 #include "preprocessor.h"
 #include "file_utils.h"
+#include "include_resolver.h"
+#include "line_features.h"
 #include "macro_utils.h"
-
+#include "protected_regions.h"
+#include "trace.h"
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <string_view>
 #include <vector>
 
 
+namespace {
+
+    /**
+     * \ifdef/\else/\endif-Zustand beim Durchlaufen von Zeilen.
+     *
+     * Ist define_keys gesetzt, gelten Zweige, deren Bedingung falsch ist,
+     * als verworfen; ohne define_keys werden alle Zweige betreten.
+     */
+    struct ConditionalState {
+        const std::unordered_set<std::string>* define_keys = nullptr;  // nullptr → alle Zweige auflösen
+        bool inside_if_block = false;
+        bool skip_if_block = false;
+
+        // true innerhalb eines verworfenen Zweigs
+        bool skipping() const { return inside_if_block && skip_if_block; }
+    };
+
+
+    /**
+     * Zustand einer Include-Auflösung.
+     *
+     * Der \ifdef-Zustand wird über Dateigrenzen hinweg mitgeführt, da
+     * process_conditionals() später auf dem zusammengefügten Dokument
+     * arbeitet. Ist conditional.define_keys gesetzt, werden Includes in
+     * Zweigen, deren Bedingung falsch ist, nicht geöffnet, sondern
+     * unverändert übernommen (und anschließend von process_conditionals()
+     * verworfen).
+     */
+    struct IncludeState {
+        std::unordered_set<std::string>& include_stack;  // aktueller Include-Pfad
+        ConditionalState conditional{};
+        FileCache* file_cache = nullptr;  // bereits gelesene Dateien
+        const FileProvider* file_provider = &disk_file_provider();  // Quelle der Include-Dateien
+        FileCache* prefetched = nullptr;  // parallel vorab gelesene Dateien (werden entnommen)
+        IncludeResolver* resolver = nullptr;  // nullptr → Namen unverändert als Pfad verwenden
+        std::vector<FileId> active_ids{};     // Identitäten des aktuellen Include-Pfads (mit resolver)
+        std::unordered_set<std::string> inserted{};   // in diesem Durchlauf eingefügte Dateien
+        VerbatimTracker verbatim{};                   // verbatim-Inhalte über Dateigrenzen hinweg
+        std::vector<std::string> missing{};           // Pfade nicht lesbarer Includes
+    };
+
+
+    /**
+     * Führt den \ifdef/\else/\endif-Zustand analog zu process_conditionals()
+     * nach. Fehler werden hier nicht gemeldet; das übernimmt
+     * process_conditionals() auf dem fertigen Dokument.
+     */
+    void track_conditional(std::string_view trimmed, ConditionalState& state) {
+
+        if (trimmed.starts_with("\\ifdef{")) {
+            if (state.inside_if_block) {
+                return;   // Verschachtelung: wird später als Fehler gemeldet
+            }
+            size_t open = trimmed.find('{');
+            size_t close = trimmed.find('}', open + 1);
+            if (close == std::string_view::npos || close <= open + 1) {
+                return;   // Syntaxfehler: Zeile bleibt wirkungslos
+            }
+            std::string macro(trimmed.substr(open + 1, close - open - 1));
+            state.inside_if_block = true;
+            state.skip_if_block = state.define_keys && !state.define_keys->contains(macro);
+        }
+        else if (trimmed == "\\else") {
+            if (state.inside_if_block && state.define_keys) {
+                state.skip_if_block = !state.skip_if_block;
+            }
+        }
+        else if (trimmed == "\\endif") {
+            state.inside_if_block = false;
+            state.skip_if_block = false;
+        }
+    }
+
+
+    /**
+     * Liest eine Include-Datei, bei vorhandenem Cache höchstens einmal.
+     */
+    std::vector<SourceLine> read_include_file(const std::string& filename, IncludeState& state) {
+
+        state.inserted.insert(filename);
+        if (state.file_cache) {
+            auto it = state.file_cache->find(filename);
+            if (it != state.file_cache->end()) {
+                return it->second;
+            }
+        }
+
+        // Vom parallelen Vorablesen (enthält nur nicht leere Dateien)
+        std::vector<SourceLine> lines;
+        if (state.prefetched) {
+            auto it = state.prefetched->find(filename);
+            if (it != state.prefetched->end()) {
+                lines = std::move(it->second);
+                state.prefetched->erase(it);
+            }
+        }
+
+        if (lines.empty()) {
+            TraceScope trace("include", filename);
+            lines = state.file_provider->read_lines(filename);
+        }
+
+        if (state.file_cache) {
+            (*state.file_cache)[filename] = lines;
+        }
+        return lines;
+    }
+
+
+    /**
+     * Rekursive Include-Auflösung (gemeinsame Implementierung von
+     * process_include() und resolve_includes()).
+     */
+    std::vector<SourceLine> expand_includes(const std::vector<SourceLine>& content,
+        PreprocReport& report,
+        IncludeState& state)
+    {
+        std::vector<SourceLine> result;
+
+        for (const SourceLine& sl : content) {
+
+            // Inhalt von verbatim-Umgebungen: weder \include noch \ifdef auswerten
+            if (state.verbatim.protects(sl.line)) {
+                result.push_back(sl);
+                continue;
+            }
+
+            // Führende Whitespaces entfernen (für \include-Erkennung)
+            std::string trimmed = sl.line;
+            trimmed.erase(0, trimmed.find_first_not_of(" \t"));
+
+            // Keine Include-Zeile → unverändert übernehmen
+            if (!trimmed.starts_with("\\include{")) {
+                track_conditional(trimmed, state.conditional);
+                result.push_back(sl);
+                continue;
+            }
+
+            // Include in einem verworfenen \ifdef-Zweig → nicht öffnen
+            if (state.conditional.skipping()) {
+                result.push_back(sl);
+                continue;
+            }
+
+            // Klammern finden
+            size_t open = trimmed.find('{');
+            size_t close = trimmed.find('}', open + 1);
+
+            if (open == std::string::npos || close == std::string::npos) {
+                report.errors.push_back({
+                    sl.file,
+                    "Syntaxfehler in \\include: fehlende geschweifte Klammern",
+                    sl.line_nr
+                });
+                result.push_back(sl);
+                continue;
+            }
+
+            // Dateiname extrahieren
+            std::string filename =
+                trimmed.substr(open + 1, close - open - 1);
+
+            if (filename.empty()) {
+                report.errors.push_back({
+                    sl.file,
+                    "\\include: Dateiname ist leer",
+                    sl.line_nr
+                });
+                result.push_back(sl);
+                continue;
+            }
+
+            // Name → Pfad (relativ zur einbindenden Datei, Arbeitsverzeichnis, -I)
+            // Identität (Gerät, Inode) erkennt dieselbe Datei unabhängig von der Schreibweise
+            // Der Cache-Schlüssel ist je Datei eindeutig, file bleibt die geschriebene Schreibweise
+            std::string path = filename;
+            std::string cache_key = filename;
+            std::optional<FileId> id;
+            if (state.resolver) {
+                if (std::optional<ResolvedInclude> resolved = state.resolver->resolve(filename, sl.file)) {
+                    path = std::move(resolved->path);
+                    cache_key = std::move(resolved->canonical);
+                    id = resolved->id;
+                }
+            }
+
+            // Zyklische Includes erkennen
+            bool cyclic = id
+                ? std::find(state.active_ids.begin(), state.active_ids.end(), *id) != state.active_ids.end()
+                : state.include_stack.contains(path);
+            if (cyclic) {
+                report.errors.push_back({
+                    sl.file,
+                    "Zyklisches \\include entdeckt: " + filename,
+                    sl.line_nr
+                });
+                result.push_back(sl);
+                continue;
+            }
+
+            // Datei lesen
+            std::vector<SourceLine> included = read_include_file(cache_key, state);
+            if (cache_key != path) {
+                for (SourceLine& included_line : included) {
+                    included_line.file = path;
+                }
+            }
+
+            if (included.empty()) {
+                report.errors.push_back({
+                    sl.file,
+                    "Include-Datei konnte nicht gelesen werden: " + filename,
+                    sl.line_nr
+                });
+                // Nicht gefunden → überall dort, wo die Datei entstehen könnte
+                if (state.resolver && !id) {
+                    std::vector<std::string> candidates = state.resolver->candidates(filename, sl.file);
+                    state.missing.insert(state.missing.end(), candidates.begin(), candidates.end());
+                }
+                else {
+                    state.missing.push_back(path);
+                }
+                result.push_back(sl);
+                continue;
+            }
+
+            // Rekursion mit Stack-Schutz
+            state.include_stack.insert(path);
+            if (id) {
+                state.active_ids.push_back(*id);
+            }
+            included = expand_includes(included, report, state);
+            if (id) {
+                state.active_ids.pop_back();
+            }
+            state.include_stack.erase(path);
+
+            // Inhalt einfügen
+            result.insert(result.end(), included.begin(), included.end());
+        }
+
+        return result;
+    }
+
+    // Obergrenze für die Fixpunkt-Iteration in resolve_includes()
+    constexpr int kMaxIncludeRounds = 16;
+
+
+    /**
+     * Entfernt Dateien aus dem Cache, die der letzte Durchlauf nicht
+     * eingefügt hat (z. B. nach Entfernen eines \include im Watch-Modus).
+     */
+    void prune_file_cache(FileCache& file_cache, const IncludeState& state) {
+        std::erase_if(file_cache, [&](const auto& entry) {
+            return !state.inserted.contains(entry.first);
+        });
+    }
+
+
+    /**
+     * Zeile ohne führende Leerzeichen und Tabs.
+     */
+    std::string_view trim_leading(std::string_view line) {
+        size_t start = line.find_first_not_of(" \t");
+        return start == std::string_view::npos ? std::string_view() : line.substr(start);
+    }
+
+
+    /**
+     * Liefert den Dateinamen einer syntaktisch gültigen \include-Zeile.
+     */
+    std::optional<std::string> include_target(std::string_view line) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 9, "\\include{") != 0) {
+            return std::nullopt;
+        }
+        size_t open = start + 8;
+        size_t close = line.find('}', open + 1);
+        if (close == std::string::npos || close == open + 1) {
+            return std::nullopt;
+        }
+        return std::string(line.substr(open + 1, close - open - 1));
+    }
+
+
+    /**
+     * true, wenn alle \ifdef-Blöcke der Datei in ihr selbst beginnen und
+     * enden (verschachtelte oder verwaiste Direktiven zählen nicht), ihre
+     * Includes also den \ifdef-Zustand des Einbindenden nicht verändern
+     * können, solange deren Blöcke ebenso ausgeglichen sind. Wird die Datei
+     * innerhalb eines Blocks betreten, darf sie keine Direktive enthalten.
+     */
+    bool balanced_conditionals(const std::vector<SourceLine>& lines, const ConditionalState& entry) {
+        VerbatimTracker verbatim;
+        bool inside = false;
+        for (const SourceLine& sl : lines) {
+            if (verbatim.protects(sl.line)) {
+                continue;
+            }
+            std::string_view trimmed = trim_leading(sl.line);
+            bool is_ifdef = trimmed.starts_with("\\ifdef{");
+            if (!is_ifdef && trimmed != "\\else" && trimmed != "\\endif") {
+                continue;
+            }
+            if (entry.inside_if_block || inside == is_ifdef) {
+                return false;
+            }
+            inside = is_ifdef || trimmed == "\\else";
+        }
+        return !inside;
+    }
+
+
+    /**
+     * Liest die Includes von lines der Reihe nach (Tiefensuche) und führt
+     * dabei den \ifdef-Zustand wie expand_includes() über Dateigrenzen
+     * hinweg mit. read_child liefert die Zeilen eines Includes.
+     *
+     * Für Dateien mit unausgeglichenen Blöcken (balanced_conditionals())
+     * und für Includes innerhalb eines Blocks: Beginnt, wechselt oder endet
+     * ein Zweig in einer anderen Datei als der Block, liegen alle Zeilen,
+     * deren Zweig sich dadurch ändert, im Teilbaum einer dieser beiden, der
+     * hier mit dem tatsächlichen Zustand gelesen wird.
+     *
+     * Rückgabe: \ifdef-Zustand am Ende von lines.
+     */
+    template <typename ReadChild>
+    ConditionalState prefetch_depth_first(const std::vector<SourceLine>& lines, const std::string* including_file,
+        ConditionalState conditional, IncludeResolver& resolver, std::vector<std::string>& path, ReadChild&& read_child)
+    {
+        VerbatimTracker verbatim;
+        for (const SourceLine& sl : lines) {
+            if (verbatim.protects(sl.line)) {
+                continue;
+            }
+            std::optional<std::string> target = include_target(sl.line);
+            if (!target) {
+                track_conditional(trim_leading(sl.line), conditional);
+                continue;
+            }
+            if (conditional.skipping()) {
+                continue;   // verworfener Zweig: nicht öffnen
+            }
+            std::optional<ResolvedInclude> resolved = resolver.resolve(*target, including_file ? *including_file : sl.file);
+            if (!resolved || std::find(path.begin(), path.end(), resolved->canonical) != path.end()) {
+                continue;   // fehlt oder zyklisch: Fehlermeldung beim Einfügen
+            }
+            std::vector<SourceLine> child = read_child(*resolved);
+            path.push_back(resolved->canonical);
+            conditional = prefetch_depth_first(child, &resolved->path, conditional, resolver, path, read_child);
+            path.pop_back();
+        }
+        return conditional;
+    }
+
+
+    /**
+     * Liest ein Include innerhalb eines gültigen \ifdef-Zweigs samt Teilbaum
+     * der Reihe nach: Ein \else oder \endif darin würde den Zweig der
+     * folgenden Includes ändern.
+     *
+     * Rückgabe: \ifdef-Zustand nach dem Include.
+     */
+    template <typename ReadChild>
+    ConditionalState prefetch_block_include(const ResolvedInclude& include, const ConditionalState& conditional,
+        IncludeResolver& resolver, ReadChild&& read_child)
+    {
+        std::vector<std::string> path{ include.canonical };
+        return prefetch_depth_first(read_child(include), &include.path, conditional, resolver, path, read_child);
+    }
+
+
+    /**
+     * Liest den Include-Baum parallel auf einem Work-Stealing-Pool ein.
+     *
+     * Jede Datei wird höchstens einmal gelesen; ihre Includes werden als
+     * neue Aufgaben in die Warteschlange des lesenden Workers gelegt, sodass
+     * unabhängige Teilbäume von leerlaufenden Workern übernommen werden.
+     * Da jeder Name nur einmal eingeplant wird, enden auch zyklische
+     * Includes. Fehler meldet erst das sequenzielle Einfügen, das auch nur
+     * tatsächlich eingefügte Dateien in den Datei-Cache übernimmt.
+     *
+     * Mit define_keys werden wie beim Einfügen keine Includes aus
+     * verworfenen \ifdef-Zweigen geöffnet. Jede Datei wird mit dem
+     * \ifdef-Zustand ihrer Include-Zeile betreten. Dateien mit
+     * unausgeglichenen Blöcken und Includes innerhalb eines Blocks werden
+     * samt Teilbaum der Reihe nach gelesen (prefetch_depth_first()), damit
+     * Blöcke über Dateigrenzen hinweg wie beim Einfügen ausgewertet werden.
+     *
+     * Rückgabe: neu gelesene, nicht leere Dateien.
+     */
+    FileCache prefetch_includes(const std::vector<SourceLine>& content,
+        const FileProvider& provider,
+        IncludeResolver& resolver,
+        const FileCache& known,
+        const std::unordered_set<std::string>* define_keys,
+        unsigned jobs)
+    {
+        std::mutex mutex;
+        std::unordered_set<std::string> scheduled;
+        FileCache fetched;
+        WorkStealingPool pool(jobs, "include");
+
+        std::function<void(const ResolvedInclude&, const ConditionalState&)> visit;
+
+        // Für die Tiefensuche: bekannte, bereits gelesene oder neu gelesene Zeilen
+        auto read_child = [&](const ResolvedInclude& include) {
+            if (auto it = known.find(include.canonical); it != known.end()) {
+                return it->second;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                scheduled.insert(include.canonical);
+                if (auto it = fetched.find(include.canonical); it != fetched.end()) {
+                    return it->second;
+                }
+            }
+            std::vector<SourceLine> lines;
+            {
+                TraceScope trace("include", include.path);
+                lines = provider.read_lines(include.canonical);
+            }
+            if (!lines.empty()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                fetched.emplace(include.canonical, lines);
+            }
+            return lines;
+        };
+
+        // including_file: Basis für relative Namen (nullptr → SourceLine::file)
+        auto schedule_children = [&](const std::vector<SourceLine>& lines, const std::string* including_file,
+            ConditionalState conditional)
+        {
+            if (conditional.define_keys && !balanced_conditionals(lines, conditional)) {
+                std::vector<std::string> path;
+                prefetch_depth_first(lines, including_file, conditional, resolver, path, read_child);
+                return;
+            }
+
+            VerbatimTracker verbatim;
+            for (const SourceLine& sl : lines) {
+                if (verbatim.protects(sl.line)) {
+                    continue;
+                }
+                std::optional<std::string> target = include_target(sl.line);
+                if (!target) {
+                    track_conditional(trim_leading(sl.line), conditional);
+                    continue;
+                }
+                if (conditional.skipping()) {
+                    continue;   // verworfener Zweig: nicht öffnen
+                }
+                std::optional<ResolvedInclude> resolved = resolver.resolve(*target, including_file ? *including_file : sl.file);
+                if (!resolved) {
+                    continue;   // fehlt: Fehlermeldung beim Einfügen
+                }
+                if (conditional.define_keys && conditional.inside_if_block) {
+                    conditional = prefetch_block_include(*resolved, conditional, resolver, read_child);
+                    continue;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!scheduled.insert(resolved->canonical).second) {   // eindeutig je Identität
+                        continue;
+                    }
+                }
+                pool.submit([&visit, include = std::move(*resolved), conditional] { visit(include, conditional); });
+            }
+        };
+
+        visit = [&](const ResolvedInclude& include, const ConditionalState& conditional) {
+            auto it = known.find(include.canonical);
+            if (it != known.end()) {
+                schedule_children(it->second, &include.path, conditional);
+                return;
+            }
+
+            std::vector<SourceLine> lines;
+            {
+                TraceScope trace("include", include.path);
+                lines = provider.read_lines(include.canonical);
+            }
+            schedule_children(lines, &include.path, conditional);
+
+            if (!lines.empty()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                fetched.emplace(include.canonical, std::move(lines));
+            }
+        };
+
+        schedule_children(content, nullptr, ConditionalState{ define_keys });
+        pool.wait_idle();
+        return fetched;
+    }
+
+
+    /**
+     * Liest den Include-Baum ebenenweise über FileProvider::batch_reader().
+     *
+     * Alle Includes einer Ebene werden in einem Stapel angefordert; auf
+     * der Festplatte reicht DiskFileProvider sie gemeinsam über einen
+     * io_uring-Ring ein, der für alle Ebenen bestehen bleibt. Wie bei prefetch_includes() wird jeder Name nur einmal
+     * eingeplant, mit define_keys bleiben verworfene \ifdef-Zweige
+     * ungelesen, und Dateien mit unausgeglichenen Blöcken sowie Includes
+     * innerhalb eines Blocks werden samt Teilbaum der Reihe nach gelesen.
+     *
+     * Rückgabe: neu gelesene, nicht leere Dateien.
+     */
+    FileCache prefetch_includes_batched(const std::vector<SourceLine>& content,
+        const FileProvider& provider,
+        IncludeResolver& resolver,
+        const FileCache& known,
+        const std::unordered_set<std::string>* define_keys)
+    {
+        // Include mit dem \ifdef-Zustand seiner Include-Zeile
+        struct PendingInclude {
+            ResolvedInclude include;
+            ConditionalState conditional;
+        };
+
+        std::unordered_set<std::string> scheduled;
+        std::vector<PendingInclude> level;
+        FileCache fetched;
+        std::unique_ptr<BatchReader> batch_reader = provider.batch_reader();   // ein Ring für alle Ebenen
+
+        // Für die Tiefensuche: bekannte, bereits gelesene oder einzeln gelesene Zeilen
+        auto read_child = [&](const ResolvedInclude& include) {
+            scheduled.insert(include.canonical);
+            if (auto it = known.find(include.canonical); it != known.end()) {
+                return it->second;
+            }
+            if (auto it = fetched.find(include.canonical); it != fetched.end()) {
+                return it->second;
+            }
+            std::vector<SourceLine> lines;
+            {
+                TraceScope trace("include", include.path);
+                lines = provider.read_lines(include.canonical);
+            }
+            if (!lines.empty()) {
+                fetched.emplace(include.canonical, lines);
+            }
+            return lines;
+        };
+
+        // including_file: Basis für relative Namen (nullptr → SourceLine::file)
+        std::function<void(const std::vector<SourceLine>&, const std::string*, ConditionalState)> collect =
+            [&](const std::vector<SourceLine>& lines, const std::string* including_file, ConditionalState conditional)
+        {
+            if (conditional.define_keys && !balanced_conditionals(lines, conditional)) {
+                std::vector<std::string> path;
+                prefetch_depth_first(lines, including_file, conditional, resolver, path, read_child);
+                return;
+            }
+
+            VerbatimTracker verbatim;
+            for (const SourceLine& sl : lines) {
+                if (verbatim.protects(sl.line)) {
+                    continue;
+                }
+                std::optional<std::string> target = include_target(sl.line);
+                if (!target) {
+                    track_conditional(trim_leading(sl.line), conditional);
+                    continue;
+                }
+                if (conditional.skipping()) {
+                    continue;   // verworfener Zweig: nicht öffnen
+                }
+                std::optional<ResolvedInclude> resolved = resolver.resolve(*target, including_file ? *including_file : sl.file);
+                if (resolved && conditional.define_keys && conditional.inside_if_block) {
+                    conditional = prefetch_block_include(*resolved, conditional, resolver, read_child);
+                    continue;
+                }
+                if (!resolved || !scheduled.insert(resolved->canonical).second) {
+                    continue;
+                }
+                auto it = known.find(resolved->canonical);
+                if (it != known.end()) {
+                    collect(it->second, &resolved->path, conditional);
+                }
+                else {
+                    level.push_back({ std::move(*resolved), conditional });
+                }
+            }
+        };
+
+        collect(content, nullptr, ConditionalState{ define_keys });
+        while (!level.empty()) {
+            std::vector<PendingInclude> batch = std::move(level);
+            level.clear();
+
+            std::vector<std::string> names;
+            for (const PendingInclude& pending : batch) {
+                names.push_back(pending.include.canonical);
+            }
+            std::vector<std::optional<std::string>> contents;
+            {
+                TraceScope trace("include", std::to_string(batch.size()) + " Dateien");
+                contents = batch_reader->read(names);
+            }
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (!contents[i]) {
+                    continue;
+                }
+                std::vector<SourceLine> lines = split_lines(*contents[i], names[i]);
+                collect(lines, &batch[i].include.path, batch[i].conditional);
+                if (!lines.empty()) {
+                    fetched.emplace(names[i], std::move(lines));
+                }
+            }
+        }
+        return fetched;
+    }
+
+
+    /**
+     * Liest den Include-Baum vorab ein, sofern die Optionen es verlangen.
+     * define_keys wie bei ConditionalState (nullptr → alle Zweige).
+     */
+    FileCache prefetch(const std::vector<SourceLine>& content,
+        const FileProvider& provider,
+        IncludeResolver& resolver,
+        const FileCache& known,
+        const std::unordered_set<std::string>* define_keys,
+        const IncludeOptions& options)
+    {
+        if (options.batch_read) {
+            return prefetch_includes_batched(content, provider, resolver, known, define_keys);
+        }
+        if (options.jobs != 1) {
+            return prefetch_includes(content, provider, resolver, known, define_keys, options.jobs);
+        }
+        return {};
+    }
+
+} // anonymer Namespace
+
+
 /**
  * Ersetzt rekursiv alle \include{...}-Anweisungen durch den Inhalt
  * der jeweils referenzierten Datei.
@@ -33,111 +683,212 @@ std::vector<SourceLine> process_include(const std::vector<SourceLine>& content,
     std::unordered_set<std::string>& include_stack
 )
 {
-    std::vector<SourceLine> result;
+    IncludeState state{ include_stack };
+    return expand_includes(content, report, state);
+}
 
-    for (const SourceLine& sl : content) {
 
-        // Führende Whitespaces entfernen (für \include-Erkennung)
-        std::string trimmed = sl.line;
-        trimmed.erase(0, trimmed.find_first_not_of(" \t"));
+/**
+ * Löst \include-Anweisungen bedingungsabhängig ("lazy") auf.
+ *
+ * Includes innerhalb von \ifdef-Zweigen, deren Bedingung falsch ist,
+ * werden nicht geöffnet. Da \define-Anweisungen auch in eingebundenen
+ * Dateien stehen können, wird bis zu einem Fixpunkt iteriert:
+ *
+ *   1. KEYs aller \define-Anweisungen des bisherigen Ergebnisses sammeln
+ *   2. Includes mit diesen KEYs auflösen
+ *   3. Ändert sich die Menge der KEYs, erneut bei 2. beginnen
+ *
+ * Jede Datei wird dabei höchstens einmal gelesen. Defines, die nur in
+ * Dateien aus verworfenen Zweigen stehen, werden nicht berücksichtigt.
+ *
+ * @param content                Eingabetext als Liste von SourceLine
+ * @param report                 Zentrale Fehler- und Warnungssammlung
+ * @param evaluate_conditionals  false → alle Zweige auflösen (wie process_include),
+ *                               z. B. wenn \ifdef nicht als Makro konfiguriert ist
+ * @param options                Datei-Cache, Dateiquelle und Parallelität
+ * @return                       Neuer SourceLine-Vektor mit aufgelösten Includes
+ */
+std::vector<SourceLine> resolve_includes(const std::vector<SourceLine>& content,
+    PreprocReport& report,
+    bool evaluate_conditionals,
+    const IncludeOptions& options)
+{
+    FileCache local_cache;
+    FileCache* file_cache = options.file_cache ? options.file_cache : &local_cache;
+    const FileProvider* file_provider =
+        options.file_provider ? options.file_provider : &disk_file_provider();
 
-        // Keine Include-Zeile → unverändert übernehmen
-        if (!trimmed.starts_with("\\include{")) {
-            result.push_back(sl);
-            continue;
-        }
+    IncludeResolver resolver(*file_provider, options.search_paths);
 
-        // Klammern finden
-        size_t open = trimmed.find('{');
-        size_t close = trimmed.find('}', open + 1);
+    std::unordered_set<std::string> keys;
+    if (evaluate_conditionals) {
+        keys = collect_define_keys(content);
+    }
 
-        if (open == std::string::npos || close == std::string::npos) {
-            report.errors.push_back({
-                sl.file,
-                "Syntaxfehler in \\include: fehlende geschweifte Klammern",
-                sl.line_nr
-            });
-            result.push_back(sl);
-            continue;
+    // Vorab lesen, eingefügt wird weiterhin in Dokumentreihenfolge
+    FileCache prefetched = prefetch(content, *file_provider, resolver, *file_cache,
+        evaluate_conditionals ? &keys : nullptr, options);
+
+    if (!evaluate_conditionals) {
+        std::unordered_set<std::string> include_stack;
+        IncludeState state{ include_stack, {}, file_cache, file_provider, &prefetched, &resolver };
+        std::vector<SourceLine> result = expand_includes(content, report, state);
+        prune_file_cache(*file_cache, state);
+        if (options.missing_files) {
+            *options.missing_files = std::move(state.missing);
         }
+        return result;
+    }
 
-        // Dateiname extrahieren
-        std::string filename =
-            trimmed.substr(open + 1, close - open - 1);
+    for (int round = 1; ; round++) {
 
-        if (filename.empty()) {
-            report.errors.push_back({
-                sl.file,
-                "\\include: Dateiname ist leer",
-                sl.line_nr
-            });
-            result.push_back(sl);
-            continue;
-        }
+        // Fehler nur aus dem letzten Durchlauf übernehmen
+        PreprocReport round_report;
+        std::unordered_set<std::string> include_stack;
+        IncludeState state{ include_stack, { &keys }, file_cache, file_provider, &prefetched, &resolver };
 
-        // Zyklische Includes erkennen
-        if (include_stack.contains(filename)) {
-            report.errors.push_back({
-                sl.file,
-                "Zyklisches \\include entdeckt: " + filename,
-                sl.line_nr
-            });
-            result.push_back(sl);
-            continue;
-        }
+        std::vector<SourceLine> result = expand_includes(content, round_report, state);
+        std::unordered_set<std::string> found = collect_define_keys(result);
 
-        // Datei lesen
-        std::vector<SourceLine> included = read_file_lines(filename);
+        if (found == keys || round == kMaxIncludeRounds) {
+            prune_file_cache(*file_cache, state);
+            if (options.missing_files) {
+                *options.missing_files = std::move(state.missing);
+            }
+            report.errors.insert(report.errors.end(),
+                round_report.errors.begin(), round_report.errors.end());
 
-        if (included.empty()) {
-            report.errors.push_back({
-                sl.file,
-                "Include-Datei konnte nicht gelesen werden: " + filename,
-                sl.line_nr
-            });
-            result.push_back(sl);
-            continue;
+            if (found != keys && !content.empty()) {
+                report.errors.push_back({
+                    content.front().file,
+                    "\\include-Auflösung konvergiert nicht (\\define und \\ifdef hängen zyklisch voneinander ab)",
+                    -1
+                });
+            }
+            return result;
         }
 
-        // Rekursion mit Stack-Schutz
-        include_stack.insert(filename);
-        included = process_include(included, report, include_stack);
-        include_stack.erase(filename);
-
-        // Inhalt einfügen
-        result.insert(result.end(), included.begin(), included.end());
+        keys = std::move(found);
     }
-
-    return result;
 }
 
 
-
 /**
- * Extrahiert alle \define-Makros aus dem LaTeX-Quelltext.
- *
- * Beispiele:
- *   \define{AUTHOR}{Max}   -> "AUTHOR" -> "Max"
- *   \define{DEBUG}         -> "DEBUG" -> ""
- * 
- * Parameter:
- *      content – Der vollständige Eingabetext, gespeichert in einem Vector vom Typ-Struct. Jedes Struct enthält eine Zeile, den Namen der Datei und die Zeilennummer. 
- * Rückgabe:
- *      Eine HashMap (unordered_map), die alle gefundenen Makros enthält.
+ * Es wird nichts eingefügt: jede Datei wird einmal gelesen und nur nach
+ * \include-Zeilen durchsucht. Syntaxfehler in \include meldet erst die
+ * vollständige Verarbeitung. Ein übergebener Datei-Cache wird genutzt,
+ * aber nicht ergänzt.
  */
-std::unordered_map<std::string, std::string> extract_defines(const std::vector<SourceLine>& content, PreprocReport& report)
+std::vector<std::string> collect_include_dependencies(const std::vector<SourceLine>& content,
+    PreprocReport& report,
+    const IncludeOptions& options)
 {
-    std::unordered_map<std::string, std::string> macros;
+    FileCache local_cache;
+    FileCache* file_cache = options.file_cache ? options.file_cache : &local_cache;
+    const FileProvider* file_provider =
+        options.file_provider ? options.file_provider : &disk_file_provider();
+
+    IncludeResolver resolver(*file_provider, options.search_paths);
+    FileCache prefetched = prefetch(content, *file_provider, resolver, *file_cache, nullptr, options);
+
+    // Identitäten statt Pfaden: auch ein Zyklus zurück zur Eingabedatei
+    // führt diese nicht erneut als Abhängigkeit auf
+    std::unordered_set<FileId> visited;
+    std::vector<std::string> dependencies;
+    if (!content.empty()) {
+        if (std::optional<FileId> root = file_provider->identity(content.front().file)) {
+            visited.insert(*root);
+        }
+    }
 
-    for (const SourceLine& sl : content) {
+    std::function<void(std::string_view, const std::string&, int)> visit_line;
+
+    // file: Basis für relative Namen (nullptr → SourceLine::file)
+    auto visit_lines = [&](const std::vector<SourceLine>& lines, const std::string* file) {
+        for (const SourceLine& sl : lines) {
+            visit_line(sl.line, file ? *file : sl.file, sl.line_nr);
+        }
+    };
+
+    // Ungelesene Dateien roh durchsuchen, ohne SourceLines anzulegen
+    auto visit_text = [&](std::string_view text, const std::string& file) {
+        int line_nr = 1;
+        for (size_t pos = 0; pos < text.size(); line_nr++) {
+            size_t end = std::min(text.find('\n', pos), text.size());
+            visit_line(text.substr(pos, end - pos), file, line_nr);
+            pos = end + 1;
+        }
+    };
+
+    // Zeilen kommen in Dokumentreihenfolge (Tiefensuche), daher genügt ein Zustand
+    VerbatimTracker verbatim;
 
+    visit_line = [&](std::string_view line, const std::string& file, int line_nr) {
+        if (verbatim.protects(line)) {
+            return;
+        }
+        std::optional<std::string> target = include_target(line);
+        if (!target) {
+            return;
+        }
+        std::optional<ResolvedInclude> resolved = resolver.resolve(*target, file);
+        if (resolved && !visited.insert(resolved->id).second) {
+            return;
+        }
+
+        std::optional<std::string> text;
+        if (resolved) {
+            if (auto it = file_cache->find(resolved->canonical); it != file_cache->end()) {
+                dependencies.push_back(resolved->path);
+                visit_lines(it->second, &resolved->path);
+                return;
+            }
+            if (auto it = prefetched.find(resolved->canonical); it != prefetched.end()) {
+                dependencies.push_back(resolved->path);
+                visit_lines(it->second, &resolved->path);
+                return;
+            }
+            TraceScope trace("include", resolved->path);
+            text = file_provider->read(resolved->path);
+        }
+
+        if (!text) {
+            report.errors.push_back({
+                file,
+                "Include-Datei konnte nicht gelesen werden: " + *target,
+                line_nr
+            });
+            return;
+        }
+        dependencies.push_back(resolved->path);
+        visit_text(*text, resolved->path);
+    };
+
+    visit_lines(content, nullptr);
+    return dependencies;
+}
+
+
+namespace {
+
+    /**
+     * Zerlegt eine einzelne \define-Zeile in KEY und VALUE.
+     *
+     * Rückgabe:
+     *   true, wenn die Zeile ein gültiges \define enthält.
+     *   false bei Nicht-Define-Zeilen und Syntaxfehlern; letztere
+     *   werden in report eingetragen.
+     */
+    bool parse_define_line(const SourceLine& sl, std::string& key, std::string& value, PreprocReport& report)
+    {
         // Führende Leerzeichen entfernen
         std::string trimmed = sl.line;
         trimmed.erase(0, trimmed.find_first_not_of(" \t"));
 
         // Keine Define-Zeile
         if (!trimmed.starts_with("\\define")) {
-            continue;
+            return false;
         }
 
         // Muss mit \define{ beginnen
@@ -147,7 +898,7 @@ std::unordered_map<std::string, std::string> extract_defines(const std::vector<S
                 "Syntaxfehler: Erwartet \\define{KEY}{...}",
                 sl.line_nr
             });
-            continue;
+            return false;
         }
 
         // KEY extrahieren
@@ -160,11 +911,10 @@ std::unordered_map<std::string, std::string> extract_defines(const std::vector<S
                 "Syntaxfehler: \\define ohne korrekt geschlossenen KEY",
                 sl.line_nr
             });
-            continue;
+            return false;
         }
 
-        std::string key =
-            trimmed.substr(key_open + 1, key_close - key_open - 1);
+        key = trimmed.substr(key_open + 1, key_close - key_open - 1);
 
 
 
@@ -176,7 +926,7 @@ std::unordered_map<std::string, std::string> extract_defines(const std::vector<S
                 "Syntaxfehler: Ungültiger Makro-Name in \\define (verschachtelte Klammern)",
                 sl.line_nr
             });
-            continue;
+            return false;
         }
 
         if (key.empty()) {
@@ -185,11 +935,11 @@ std::unordered_map<std::string, std::string> extract_defines(const std::vector<S
                 "Syntaxfehler: KEY darf nicht leer sein",
                 sl.line_nr
             });
-            continue;
+            return false;
         }
 
         // ggf. VALUE extrahieren 
-        std::string value;
+        value.clear();
         size_t pos = key_close + 1;
 
         // Bounds-Check
@@ -204,7 +954,7 @@ std::unordered_map<std::string, std::string> extract_defines(const std::vector<S
                     "Syntaxfehler: Unvollständige Value-Klammern in \\define",
                     sl.line_nr
                 });
-                continue;
+                return false;
             }
 
             value = trimmed.substr(
@@ -214,18 +964,322 @@ std::unordered_map<std::string, std::string> extract_defines(const std::vector<S
         }
         // else: kein Value → value bleibt ""
 
+        return true;
+    }
+
+
+    /**
+     * Prüft, ob ein Zeichen Teil eines Bezeichners ist.
+     *
+     * Als Bezeichnerzeichen gelten:
+     *  - Buchstaben (A–Z, a–z)
+     *  - Ziffern (0–9)
+     *  - Unterstrich (_)
+     *
+     * Diese Definition wird verwendet, um Wortgrenzen zu erkennen
+     * und Teilersetzungen (z. B. AUTHOR in AUTHOR_NAME) zu vermeiden.
+     */
+    bool is_ident_char(unsigned char c) {
+        return std::isalnum(c) || c == '_';
+    }
+
+
+
+    using DefineEntry = std::pair<const std::string, std::string>;
+
+    /**
+     * Findet \define-Schlüssel an einer Textposition.
+     *
+     * Schlüssel aus Bezeichnerzeichen werden über das an der Position
+     * beginnende Wort in der Tabelle nachgeschlagen. Alle übrigen
+     * (z. B. "MY KEY") sind nach ihrem ersten Zeichen vorsortiert und
+     * werden längste zuerst verglichen.
+     */
+    class DefineMatcher {
+    public:
+        explicit DefineMatcher(const std::unordered_map<std::string, std::string>& defines)
+            : defines_(defines)
+        {
+            for (const DefineEntry& entry : defines) {
+                const std::string& key = entry.first;
+                if (key.empty()) {
+                    continue;
+                }
+                if (std::all_of(key.begin(), key.end(), [](char c) { return is_ident_char(static_cast<unsigned char>(c)); })) {
+                    min_word_ = std::min(min_word_, key.size());
+                    max_word_ = std::max(max_word_, key.size());
+                    word_mask_ |= word_bit(key);
+                }
+                else {
+                    irregular_[static_cast<unsigned char>(key[0])].push_back(&entry);
+                    has_irregular_ = true;
+                }
+            }
+            for (auto& candidates : irregular_) {
+                std::sort(candidates.begin(), candidates.end(), [](const DefineEntry* a, const DefineEntry* b) {
+                    return a->first.size() != b->first.size() ? a->first.size() > b->first.size() : a->first < b->first;
+                });
+            }
+        }
+
+        // false, wenn laut Bloom-Filter der Zeile kein Schlüssel darin vorkommt.
+        bool may_match(const LineFeatures& features) const {
+            return has_irregular_ || features.may_contain_words(word_mask_);
+        }
+
+        /**
+         * Define, dessen Schlüssel bei pos beginnt und rechts an einer
+         * Wortgrenze endet (die linke prüft der Aufrufer), sonst nullptr.
+         * word_end erhält das Ende des bei pos beginnenden Worts.
+         */
+        const DefineEntry* match(const std::string& text, size_t pos, size_t& word_end) const {
+            word_end = pos;
+            while (word_end < text.size() && is_ident_char(static_cast<unsigned char>(text[word_end]))) {
+                word_end++;
+            }
+            size_t word_size = word_end - pos;
+
+            // Ein Schlüssel mit Nicht-Bezeichnerzeichen passt nur, wenn er über das Wort hinausreicht
+            for (const DefineEntry* entry : irregular_[static_cast<unsigned char>(text[pos])]) {
+                const std::string& key = entry->first;
+                if (key.size() <= word_size) {
+                    break;
+                }
+                size_t right = pos + key.size();
+                if (text.compare(pos, key.size(), key) == 0 &&
+                    (right >= text.size() || !is_ident_char(static_cast<unsigned char>(text[right])))) {
+                    return entry;
+                }
+            }
+
+            if (word_size < min_word_ || word_size > max_word_) {
+                return nullptr;
+            }
+            auto it = defines_.find(text.substr(pos, word_size));
+            return it != defines_.end() ? &*it : nullptr;
+        }
+
+    private:
+        const std::unordered_map<std::string, std::string>& defines_;
+        std::array<std::vector<const DefineEntry*>, 256> irregular_{};
+        size_t min_word_ = SIZE_MAX;
+        size_t max_word_ = 0;
+        uint64_t word_mask_ = 0;      // Bloom-Bits aller Schlüssel aus Bezeichnerzeichen
+        bool has_irregular_ = false;
+    };
+
+
+    /**
+     * Ersetzt alle Schlüssel in text in einem Durchlauf von links nach
+     * rechts durch value_of(entry). Eingesetzte Werte werden nicht erneut
+     * durchsucht; Wortgrenzen beziehen sich auf den ursprünglichen Text.
+     *
+     * Rückgabe: true, wenn ersetzt wurde (Ergebnis in out), sonst false.
+     */
+    template <typename ValueOf>
+    bool substitute_defines(const std::string& text, const DefineMatcher& matcher, ValueOf&& value_of, std::string& out)
+    {
+        size_t copied = 0;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            if (pos > 0 && is_ident_char(static_cast<unsigned char>(text[pos - 1]))) {
+                pos++;
+                continue;
+            }
+
+            size_t word_end = pos;
+            const DefineEntry* entry = matcher.match(text, pos, word_end);
+            if (!entry) {
+                pos = std::max(word_end, pos + 1);
+                continue;
+            }
+
+            if (copied == 0) {
+                out.clear();
+            }
+            out.append(text, copied, pos - copied);
+            out += value_of(*entry);
+            pos += entry->first.size();
+            copied = pos;
+        }
+
+        if (copied == 0) {
+            return false;
+        }
+        out.append(text, copied, std::string::npos);
+        return true;
+    }
+
+
+    /**
+     * Setzt in die Werte aller Defines die Werte der darin vorkommenden
+     * Defines ein, bis keine Schlüssel mehr übrig sind (Fixpunkt).
+     *
+     * Jeder Wert wird genau einmal aufgelöst, unabhängig von der Länge
+     * einer Kette A → B → C; die Tiefensuche läuft über einen eigenen
+     * Stapel statt über Rekursion. Zyklen (auch A → A) erzeugen eine
+     * Warnung; der Schlüssel, der den Zyklus schließt, bleibt als Text
+     * stehen. Die Schlüssel werden nach Namen abgearbeitet, damit auch
+     * das Ergebnis bei Zyklen nicht von der Hash-Reihenfolge abhängt.
+     */
+    void resolve_define_values(std::unordered_map<std::string, std::string>& defines,
+        const std::unordered_map<std::string, const SourceLine*>& origins)
+    {
+        enum class State : uint8_t { Open, Active, Done };
+
+        // Ein Define auf dem Auflösungspfad mit den Defines in seinem Wert
+        struct Frame {
+            DefineEntry* entry;
+            std::vector<const DefineEntry*> refs;   // in Reihenfolge des ersten Vorkommens
+            size_t next = 0;                        // nächster zu prüfender Verweis
+        };
+
+        DefineMatcher matcher(defines);
+        std::unordered_map<const DefineEntry*, State> states;
+        std::vector<Frame> active;   // aktueller Auflösungspfad
+        std::string resolved;
+
+        auto open = [&](DefineEntry& entry) {
+            states[&entry] = State::Active;
+            Frame frame{ &entry, {} };
+            substitute_defines(entry.second, matcher, [&](const DefineEntry& ref) -> const std::string& {
+                if (std::find(frame.refs.begin(), frame.refs.end(), &ref) == frame.refs.end()) {
+                    frame.refs.push_back(&ref);
+                }
+                return ref.second;
+            }, resolved);
+            active.push_back(std::move(frame));
+        };
+
+        auto warn_cycle = [&](const DefineEntry& ref) {
+            std::string cycle;
+            auto start = std::find_if(active.begin(), active.end(),
+                [&](const Frame& frame) { return frame.entry == &ref; });
+            for (auto it = start; it != active.end(); ++it) {
+                cycle += it->entry->first + " -> ";
+            }
+            const SourceLine* origin = origins.at(ref.first);
+            std::cout << "Warnung: Zyklische Definition in \\define: " << cycle << ref.first
+                << " (" << origin->file << ":" << origin->line_nr << "), '"
+                << ref.first << "' bleibt als Text stehen" << "\n";
+        };
+
+        std::vector<DefineEntry*> sorted;
+        for (DefineEntry& entry : defines) {
+            sorted.push_back(&entry);
+        }
+        std::sort(sorted.begin(), sorted.end(),
+            [](const DefineEntry* a, const DefineEntry* b) { return a->first < b->first; });
+
+        for (DefineEntry* root : sorted) {
+            if (states[root] != State::Open) {
+                continue;
+            }
+            open(*root);
+
+            while (!active.empty()) {
+                Frame& frame = active.back();
+
+                // Zuerst alle Verweise auflösen
+                if (frame.next < frame.refs.size()) {
+                    const DefineEntry* ref = frame.refs[frame.next++];
+                    State state = states[ref];
+                    if (state == State::Open) {
+                        open(*const_cast<DefineEntry*>(ref));
+                    }
+                    else if (state == State::Active) {
+                        warn_cycle(*ref);
+                    }
+                    continue;
+                }
+
+                // Verweise auf Defines des Pfads schließen einen Zyklus und bleiben stehen
+                DefineEntry& entry = *frame.entry;
+                if (substitute_defines(entry.second, matcher, [&](const DefineEntry& ref) -> const std::string& {
+                        return states[&ref] == State::Active ? ref.first : ref.second;
+                    }, resolved)) {
+                    entry.second.swap(resolved);
+                }
+                states[&entry] = State::Done;
+                active.pop_back();
+            }
+        }
+    }
+
+} // anonymer Namespace
+
+
+/**
+ * Extrahiert alle \define-Makros aus dem LaTeX-Quelltext.
+ *
+ * Beispiele:
+ *   \define{AUTHOR}{Max}   -> "AUTHOR" -> "Max"
+ *   \define{DEBUG}         -> "DEBUG" -> ""
+ *
+ * Werte, die andere Defines enthalten, werden vollständig aufgelöst
+ * zurückgegeben (\define{A}{B!} mit \define{B}{x} -> "A" -> "x!").
+ * Zyklische Definitionen erzeugen eine Warnung; der Schlüssel, der den
+ * Zyklus schließt, bleibt als Text stehen (\define{C}{C+1} -> "C" -> "C+1").
+ * 
+ * Parameter:
+ *      content – Der vollständige Eingabetext, gespeichert in einem Vector vom Typ-Struct. Jedes Struct enthält eine Zeile, den Namen der Datei und die Zeilennummer. 
+ * Rückgabe:
+ *      Eine HashMap (unordered_map), die alle gefundenen Makros enthält.
+ */
+std::unordered_map<std::string, std::string> extract_defines(const std::vector<SourceLine>& content, PreprocReport& report)
+{
+    std::unordered_map<std::string, std::string> macros;
+    std::unordered_map<std::string, const SourceLine*> origins;   // letzte Definition je KEY
+    std::string key;
+    std::string value;
+
+    for (const SourceLine& sl : content) {
+
+        if (!parse_define_line(sl, key, value, report)) {
+            continue;
+        }
+
         // Doppelte Keys
         if (macros.contains(key)) {
             std::cout << "Warnung: Makro '" + key + "' wird überschrieben" << "\n";
         }
 
         macros[key] = value;
+        origins[key] = &sl;
     } 
+
+    // Verweise auf andere Defines in den Werten einmalig auflösen
+    resolve_define_values(macros, origins);
     
     return macros;
 }
 
 
+/**
+ * Sammelt nur die KEYs aller gültigen \define-Anweisungen.
+ *
+ * Wird während der Include-Auflösung benötigt, um \ifdef-Bedingungen
+ * vorab auszuwerten. Syntaxfehler werden hier ignoriert; sie werden
+ * später von extract_defines() gemeldet.
+ */
+std::unordered_set<std::string> collect_define_keys(const std::vector<SourceLine>& content)
+{
+    std::unordered_set<std::string> keys;
+    PreprocReport ignored;
+    std::string key;
+    std::string value;
+
+    VerbatimTracker verbatim;
+
+    for (const SourceLine& sl : content) {
+        if (!verbatim.protects(sl.line) && parse_define_line(sl, key, value, ignored)) {
+            keys.insert(key);
+        }
+    }
+    return keys;
+}
+
+
 /**
  * Entfernt alle syntaktisch erkannten \define{...}-Anweisungen aus dem Quelltext.
  *
@@ -237,50 +1291,48 @@ std::unordered_map<std::string, std::string> extract_defines(const std::vector<S
  * unverändert beibehalten. Die eigentliche Validierung erfolgt in extract_defines().
  *
  * Parameter:
- *   content - Vektor von SourceLine-Strukturen (Text, Datei, originale Zeilennummer)
+ *   content  - Vektor von SourceLine-Strukturen (Text, Datei, originale Zeilennummer)
+ *   features - Optionale Zeilenmerkmale zu content (line_features.h),
+ *              danach passend zum Ergebnis
  *
  * Rückgabe:
  *   Neuer Vektor von SourceLine ohne \define-Zeilen.
  *   Die ursprünglichen Dateinamen und Zeilennummern bleiben erhalten.
  */
-std::vector<SourceLine> remove_defines(const std::vector<SourceLine>& content) {
+std::vector<SourceLine> remove_defines(const std::vector<SourceLine>& content, std::vector<LineFeatures>* features) {
     std::vector<SourceLine> result;
-   
-    for (const SourceLine& sl : content) {
+    size_t kept = 0;   // übernommene Merkmale, vorn in features zusammengeschoben
+    fit_line_features(features, content.size());
 
-        // Führende Whitespaces entfernen (Indentierung ignorieren)
-        std::string trimmed = sl.line;
-        trimmed.erase(0, trimmed.find_first_not_of(" \t"));
+    for (size_t i = 0; i < content.size(); i++) {
+        const SourceLine& sl = content[i];
 
-        // Nur echte \define{...}-Zeilen entfernen
-        if (!trimmed.starts_with("\\define{")) {
-            result.push_back(sl);
-        }
-    }
-
-    return result;
-}
+        // Zeilen ohne Direktive können kein \define sein
+        LineFeatures line_features = line_features_at(features, i, sl);
+        if (line_features.has(kLineDirective)) {
 
+            // Führende Whitespaces entfernen (Indentierung ignorieren)
+            std::string trimmed = sl.line;
+            trimmed.erase(0, trimmed.find_first_not_of(" \t"));
 
+            // Nur echte \define{...}-Zeilen entfernen
+            if (trimmed.starts_with("\\define{")) {
+                continue;
+            }
+        }
 
-namespace {
+        result.push_back(sl);
+        if (features) {
+            (*features)[kept++] = line_features;
+        }
+    }
 
-    /**
-     * Prüft, ob ein Zeichen Teil eines Bezeichners ist.
-     *
-     * Als Bezeichnerzeichen gelten:
-     *  - Buchstaben (A–Z, a–z)
-     *  - Ziffern (0–9)
-     *  - Unterstrich (_)
-     *
-     * Diese Definition wird verwendet, um Wortgrenzen zu erkennen
-     * und Teilersetzungen (z. B. AUTHOR in AUTHOR_NAME) zu vermeiden.
-     */
-    bool is_ident_char(unsigned char c) {
-        return std::isalnum(c) || c == '_';
+    if (features) {
+        features->resize(kept);
     }
+    return result;
+}
 
-} // anonymer Namespace
 
 
 /**
@@ -294,55 +1346,46 @@ namespace {
  *   Defines: {"AUTHOR" -> "Max"}
  *   Ergebnis: "AUTHOR_NAME ist Max."
  *
+ * Jede Zeile wird in einem Durchlauf von links nach rechts ersetzt; passen
+ * an einer Stelle mehrere Schlüssel, gewinnt der längste. Eingesetzte Werte
+ * werden nicht erneut durchsucht, das Ergebnis hängt damit nicht von der
+ * Reihenfolge der Map ab. Verweise zwischen Defines löst bereits
+ * extract_defines() auf.
+ *
  * Parameter:
- *   text    – Eingabetext als Vektor von SourceLine-Strukturen
- *   macros  – HashMap mit \define-Makros (Key -> Value)
+ *   text     – Eingabetext als Vektor von SourceLine-Strukturen
+ *   macros   – HashMap mit \define-Makros (Key -> Value)
+ *   features – Optionale Zeilenmerkmale zu text (line_features.h),
+ *              danach passend zum Ergebnis
  *
  * Rückgabe:
  *   Neuer Vektor von SourceLine mit ersetzten Makros
  */
 std::vector<SourceLine> replace_text_macros(
     const std::vector<SourceLine>& text,
-    const std::unordered_map<std::string, std::string>& macros)
+    const std::unordered_map<std::string, std::string>& macros,
+    std::vector<LineFeatures>* features)
 {
     // Kopie, damit Originaldaten erhalten bleiben
     std::vector<SourceLine> result = text;
 
-    // Für jedes definierte Makro
-    for (const auto& [key, value] : macros) {
+    if (macros.empty()) {
+        return result;
+    }
 
-        if (key.empty()) {
+    // Ein Durchlauf je Zeile, unabhängig von Anzahl und Reihenfolge der Defines
+    DefineMatcher matcher(macros);
+    std::string replaced;
+    fit_line_features(features, result.size());
+    for (size_t i = 0; i < result.size(); i++) {
+        SourceLine& sl = result[i];
+        if (!matcher.may_match(line_features_at(features, i, sl))) {
             continue;
         }
-
-        // Jede Zeile separat verarbeiten
-        for (SourceLine& sl : result) {
-
-            size_t pos = 0;
-
-            // Alle Vorkommen des Makros in der Zeile finden
-            while ((pos = sl.line.find(key, pos)) != std::string::npos) {
-
-                // Linke Wortgrenze prüfen
-                bool left_ok =
-                    (pos == 0) ||
-                    !is_ident_char(static_cast<unsigned char>(sl.line[pos - 1]));
-
-                // Rechte Wortgrenze prüfen
-                size_t right_index = pos + key.size();
-                bool right_ok =
-                    (right_index >= sl.line.size()) ||
-                    !is_ident_char(static_cast<unsigned char>(sl.line[right_index]));
-
-                if (left_ok && right_ok) {
-                    // Exakter Treffer → ersetzen
-                    sl.line.replace(pos, key.size(), value);
-                    pos += value.size(); // hinter die Ersetzung springen
-                }
-                else {
-                    // Kein exakter Treffer → weiter suchen
-                    pos += key.size();
-                }
+        if (substitute_defines(sl.line, matcher, [](const DefineEntry& entry) -> const std::string& { return entry.second; }, replaced)) {
+            sl.line.swap(replaced);
+            if (features) {
+                (*features)[i] = LineFeatures{};
             }
         }
     }
@@ -362,6 +1405,8 @@ std::vector<SourceLine> replace_text_macros(
  *   text     – Quelltext als Liste von SourceLine (inkl. Datei & Zeilennummer)
  *   defines  – zuvor extrahierte \define-Makros
  *   report   – Fehler- und Warnungssammlung
+ *   features – Optionale Zeilenmerkmale zu text (line_features.h),
+ *              danach passend zum Ergebnis
  *
  * Rückgabe:
  *   Gefilterter Text mit entfernten/aktivierten Ifdef-Blöcken
@@ -369,9 +1414,20 @@ std::vector<SourceLine> replace_text_macros(
 std::vector<SourceLine> process_conditionals(
     const std::vector<SourceLine>& text,
     const std::unordered_map<std::string, std::string>& defines,
-    PreprocReport& report
+    PreprocReport& report,
+    std::vector<LineFeatures>* features
 ) {
     std::vector<SourceLine> result;
+    size_t kept = 0;   // übernommene Merkmale, vorn in features zusammengeschoben
+    fit_line_features(features, text.size());
+
+    // Übernimmt Zeile i samt Merkmalen ins Ergebnis
+    auto keep = [&](size_t i, const LineFeatures& line_features) {
+        result.push_back(text[i]);
+        if (features) {
+            (*features)[kept++] = line_features;
+        }
+    };
 
     bool inside_if_block = false;
     bool skip_if_block = false;
@@ -379,7 +1435,17 @@ std::vector<SourceLine> process_conditionals(
     int if_start_line = -1;
     std::string if_start_file;
 
-    for (const SourceLine& sl : text) {
+    for (size_t i = 0; i < text.size(); i++) {
+        const SourceLine& sl = text[i];
+
+        // Zeilen ohne Direktive direkt übernehmen bzw. verwerfen
+        LineFeatures line_features = line_features_at(features, i, sl);
+        if (!line_features.has(kLineDirective)) {
+            if (!inside_if_block || !skip_if_block) {
+                keep(i, line_features);
+            }
+            continue;
+        }
 
         // Führende Whitespaces entfernen (Direktiven tolerant erkennen)
         std::string trimmed = sl.line;
@@ -407,7 +1473,7 @@ std::vector<SourceLine> process_conditionals(
                     "Syntaxfehler in \\ifdef: Erwartet \\ifdef{NAME}",
                     sl.line_nr
                 });
-                result.push_back(sl);
+                keep(i, line_features);
                 continue;
             }
 
@@ -457,7 +1523,7 @@ std::vector<SourceLine> process_conditionals(
 
         // ---------- Normale Zeilen ----------
         if (!inside_if_block || !skip_if_block) {
-            result.push_back(sl);
+            keep(i, line_features);
         }
     }
 
@@ -471,6 +1537,9 @@ std::vector<SourceLine> process_conditionals(
         });
     }
 
+    if (features) {
+        features->resize(kept);
+    }
     return result;
 }
 
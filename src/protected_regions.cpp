@@ -0,0 +1,221 @@
+#include "protected_regions.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <string_view>
+
+
+namespace {
+
+    constexpr char kMarkerBegin = '\x01';
+    constexpr char kMarkerEnd = '\x02';
+    constexpr char kDigitBase = '\x10';   // Hex-Ziffern als '\x10'..'\x1f'
+
+    constexpr std::array<std::string_view, 9> kVerbatimEnvironments{
+        "verbatim", "verbatim*", "Verbatim", "Verbatim*", "BVerbatim", "LVerbatim",
+        "lstlisting", "minted", "comment"
+    };
+
+
+    // Platzhalter für den Bereich mit diesem Index (keine druckbaren Zeichen).
+    void append_marker(std::string& out, size_t index) {
+        out += kMarkerBegin;
+        size_t shift = 0;
+        while (shift + 4 < sizeof(size_t) * 8 && (index >> (shift + 4)) != 0) {
+            shift += 4;
+        }
+        for (;; shift -= 4) {
+            out += static_cast<char>(kDigitBase + ((index >> shift) & 0xf));
+            if (shift == 0) {
+                break;
+            }
+        }
+        out += kMarkerEnd;
+    }
+
+
+    /**
+     * Baut eine Zeile neu auf, in der einzelne Bereiche durch Platzhalter
+     * ersetzt werden. Ohne geschützten Bereich bleibt die Zeile unverändert.
+     */
+    class LineMasker {
+    public:
+        LineMasker(std::string& line, std::vector<std::string>& regions)
+            : line_(line), regions_(regions) {}
+
+        void protect(size_t begin, size_t end) {
+            if (begin >= end) {
+                return;
+            }
+            out_.append(line_, copied_, begin - copied_);
+            append_marker(out_, regions_.size());
+            regions_.push_back(line_.substr(begin, end - begin));
+            copied_ = end;
+        }
+
+        void finish() {
+            if (copied_ > 0) {
+                out_.append(line_, copied_, std::string::npos);
+                line_.swap(out_);
+            }
+        }
+
+    private:
+        std::string& line_;
+        std::vector<std::string>& regions_;
+        std::string out_;
+        size_t copied_ = 0;
+    };
+
+} // anonymer Namespace
+
+
+namespace {
+
+    /**
+     * Sucht in einer Zeile die geschützten Bereiche und meldet sie über
+     * protect(begin, end). environment ist die aktuelle verbatim-Umgebung
+     * (leer = keine) und wird über Zeilen hinweg fortgeschrieben.
+     *
+     * In normalem Text werden nur die Zeichen '%', '\\' und bereits
+     * vorhandene '\x01' näher betrachtet.
+     */
+    template <typename Protect>
+    void scan_line(std::string_view line, std::string& environment, Protect&& protect) {
+
+        size_t pos = 0;
+
+        // Inhalt einer verbatim-Umgebung bis vor \end{...}
+        if (!environment.empty()) {
+            size_t end = line.find("\\end{" + environment + "}");
+            if (end == std::string_view::npos) {
+                protect(0, line.size());
+                return;
+            }
+            protect(0, end);
+            pos = end + environment.size() + 6;
+            environment.clear();
+        }
+
+        while ((pos = line.find_first_of("%\\\x01", pos)) != std::string_view::npos) {
+
+            // Kommentar bis zum Zeilenende
+            if (line[pos] == '%') {
+                protect(pos, line.size());
+                return;
+            }
+
+            // Vorhandene Platzhalterzeichen ebenfalls schützen, damit restore() eindeutig bleibt
+            if (line[pos] == kMarkerBegin) {
+                protect(pos, pos + 1);
+                pos++;
+                continue;
+            }
+
+            // Maskierte Zeichen wie "\%" und "\\"
+            if (pos + 1 < line.size() && !std::isalpha(static_cast<unsigned char>(line[pos + 1]))) {
+                pos += 2;
+                continue;
+            }
+
+            // \verb|...| bzw. \verb*|...|
+            if (line.compare(pos, 5, "\\verb") == 0 &&
+                (pos + 5 == line.size() || !std::isalpha(static_cast<unsigned char>(line[pos + 5])))) {
+                size_t delimiter = pos + 5;
+                if (delimiter < line.size() && line[delimiter] == '*') {
+                    delimiter++;
+                }
+                if (delimiter >= line.size()) {
+                    return;
+                }
+                size_t close = line.find(line[delimiter], delimiter + 1);
+                size_t end = (close == std::string_view::npos) ? line.size() : close + 1;
+                protect(pos, end);
+                pos = end;
+                continue;
+            }
+
+            // \begin{verbatim} usw.: geschützt ab der nächsten Zeile
+            if (line.compare(pos, 7, "\\begin{") == 0) {
+                size_t close = line.find('}', pos + 7);
+                if (close != std::string_view::npos) {
+                    std::string_view name = line.substr(pos + 7, close - pos - 7);
+                    if (std::find(kVerbatimEnvironments.begin(), kVerbatimEnvironments.end(), name) != kVerbatimEnvironments.end()) {
+                        environment = name;
+                        return;
+                    }
+                }
+            }
+            pos++;
+        }
+    }
+
+} // anonymer Namespace
+
+
+/**
+ * Läuft einmal über das Dokument; Zeilen ohne geschützten Bereich werden
+ * nicht kopiert.
+ */
+std::vector<SourceLine> ProtectedRegions::hide(std::vector<SourceLine> text) {
+
+    std::string environment;   // aktuelle verbatim-Umgebung, leer = keine
+
+    for (SourceLine& sl : text) {
+        LineMasker masker(sl.line, regions_);
+        scan_line(sl.line, environment, [&](size_t begin, size_t end) {
+            masker.protect(begin, end);
+        });
+        masker.finish();
+    }
+
+    return text;
+}
+
+
+bool VerbatimTracker::protects(std::string_view line) {
+    // Ohne \begin{ kann außerhalb einer Umgebung keine beginnen
+    if (environment_.empty() && line.find("\\begin{") == std::string_view::npos) {
+        return false;
+    }
+    bool inside = !environment_.empty();
+    scan_line(line, environment_, [](size_t, size_t) {});
+    return inside;
+}
+
+
+std::vector<SourceLine> ProtectedRegions::restore(std::vector<SourceLine> text) const {
+
+    if (regions_.empty()) {
+        return text;
+    }
+
+    for (SourceLine& sl : text) {
+        size_t pos = sl.line.find(kMarkerBegin);
+        if (pos == std::string::npos) {
+            continue;
+        }
+
+        std::string out;
+        size_t copied = 0;
+        for (; pos != std::string::npos; pos = sl.line.find(kMarkerBegin, pos + 1)) {
+            size_t index = 0;
+            size_t end = pos + 1;
+            while (end < sl.line.size() && sl.line[end] >= kDigitBase && sl.line[end] < kDigitBase + 16) {
+                index = index * 16 + static_cast<size_t>(sl.line[end] - kDigitBase);
+                end++;
+            }
+            if (end == pos + 1 || end >= sl.line.size() || sl.line[end] != kMarkerEnd || index >= regions_.size()) {
+                continue;
+            }
+            out.append(sl.line, copied, pos - copied);
+            out += regions_[index];
+            copied = end + 1;
+            pos = end;
+        }
+        out.append(sl.line, copied, std::string::npos);
+        sl.line.swap(out);
+    }
+    return text;
+}
@@ -0,0 +1,81 @@
+#include "source_map.h"
+#include "json.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+
+void SourceMap::add(const SourceLine& sl) {
+
+    auto [it, inserted] = file_ids_.try_emplace(sl.file, static_cast<int>(files_.size()));
+    if (inserted) {
+        files_.push_back(sl.file);
+    }
+    int file_id = it->second;
+
+    // Bestehenden Bereich verlängern, wenn die Zeile direkt anschließt
+    bool extended = false;
+    if (!ranges_.empty()) {
+        Range& last = ranges_.back();
+        if (last.file_id == file_id && last.original_start + last.count == sl.line_nr) {
+            last.count++;
+            extended = true;
+        }
+    }
+    if (!extended) {
+        ranges_.push_back({ next_output_line_, 1, file_id, sl.line_nr });
+    }
+    next_output_line_++;
+
+    // Ersetzungen mit '\n' ergeben weitere Ausgabezeilen derselben Herkunft
+    for (char c : sl.line) {
+        if (c == '\n') {
+            ranges_.push_back({ next_output_line_, 1, file_id, sl.line_nr });
+            next_output_line_++;
+        }
+    }
+}
+
+
+std::optional<SourceMap::Location> SourceMap::lookup(int output_line) const {
+
+    // Letzten Bereich mit output_start <= output_line suchen
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), output_line,
+        [](int line, const Range& r) { return line < r.output_start; });
+
+    if (it == ranges_.begin()) {
+        return std::nullopt;
+    }
+    const Range& r = *std::prev(it);
+    if (output_line >= r.output_start + r.count) {
+        return std::nullopt;
+    }
+    return Location{ files_[r.file_id], r.original_start + (output_line - r.output_start) };
+}
+
+
+bool SourceMap::write(const std::string& path) const {
+
+    nlohmann::json ranges = nlohmann::json::array();
+    for (const Range& r : ranges_) {
+        ranges.push_back(r.output_start);
+        ranges.push_back(r.count);
+        ranges.push_back(r.file_id);
+        ranges.push_back(r.original_start);
+    }
+
+    nlohmann::json map = {
+        { "version", 1 },
+        { "files", files_ },
+        { "ranges", ranges }
+    };
+
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "+++ Fehler beim Schreiben der Source-Map: " << path << " +++\n";
+        return false;
+    }
+    out << map.dump() << "\n";
+    return true;
+}
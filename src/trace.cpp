@@ -0,0 +1,145 @@
+#include "trace.h"
+#include "json.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+
+namespace trace_detail {
+    std::atomic<bool> g_enabled{ false };
+}
+
+
+namespace {
+
+    struct TraceEvent {
+        std::string name;
+        const char* category;
+        double ts_us;     // Beginn relativ zum Aufzeichnungsstart
+        double dur_us;    // Dauer
+        int tid;
+    };
+
+    std::mutex g_mutex;
+    std::vector<TraceEvent> g_events;
+    std::vector<std::pair<int, std::string>> g_thread_names;
+    std::chrono::steady_clock::time_point g_origin;
+    std::atomic<int> g_next_tid{ 1 };
+
+    /**
+     * Liefert eine kleine, stabile Thread-Nummer für die Trace-Ansicht.
+     */
+    int current_tid() {
+        thread_local int tid = g_next_tid.fetch_add(1, std::memory_order_relaxed);
+        return tid;
+    }
+
+    double micros_since_origin(std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double, std::micro>(t - g_origin).count();
+    }
+
+} // anonymer Namespace
+
+
+void trace_enable() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_origin = std::chrono::steady_clock::now();
+    g_events.clear();
+    trace_detail::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+
+void trace_disable() {
+    trace_detail::g_enabled.store(false, std::memory_order_relaxed);
+}
+
+
+void trace_set_thread_name(const std::string& name) {
+    if (!trace_enabled()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_thread_names.emplace_back(current_tid(), name);
+}
+
+
+TraceScope::TraceScope(const char* category, std::string_view name) {
+    if (!trace_enabled()) {
+        return;
+    }
+    active_ = true;
+    category_ = category;
+    name_ = name;
+    start_ = std::chrono::steady_clock::now();
+}
+
+
+TraceScope::~TraceScope() {
+    if (!active_) {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    TraceEvent event{
+        std::move(name_),
+        category_,
+        micros_since_origin(start_),
+        std::chrono::duration<double, std::micro>(end - start_).count(),
+        current_tid()
+    };
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_events.push_back(std::move(event));
+}
+
+
+/**
+ * Schreibt die Events im Chrome-Trace-Event-Format:
+ *   {"traceEvents":[{"name":..,"cat":..,"ph":"X","ts":..,"dur":..,"pid":1,"tid":..}],
+ *    "displayTimeUnit":"ms"}
+ */
+bool write_trace(const std::string& path) {
+
+    nlohmann::json events = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+
+        for (const auto& [tid, name] : g_thread_names) {
+            events.push_back({
+                { "name", "thread_name" },
+                { "ph", "M" },
+                { "pid", 1 },
+                { "tid", tid },
+                { "args", { { "name", name } } }
+            });
+        }
+
+        for (const TraceEvent& e : g_events) {
+            events.push_back({
+                { "name", e.name },
+                { "cat", e.category },
+                { "ph", "X" },
+                { "ts", e.ts_us },
+                { "dur", e.dur_us },
+                { "pid", 1 },
+                { "tid", e.tid }
+            });
+        }
+    }
+
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "+++ Fehler beim Öffnen der Trace-Datei: " << path << " +++\n";
+        return false;
+    }
+
+    nlohmann::json trace = {
+        { "traceEvents", events },
+        { "displayTimeUnit", "ms" }
+    };
+    // Dateinamen müssen kein gültiges UTF-8 sein → ungültige Bytes ersetzen statt abbrechen
+    out << trace.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) << "\n";
+    std::cout << "Trace gespeichert: " << path << "\n";
+    return true;
+}
@@ -0,0 +1,121 @@
+#include "work_stealing_pool.h"
+#include "trace.h"
+
+#include <algorithm>
+
+
+namespace {
+
+    // Index des Workers im aktuellen Thread (nur innerhalb seines Pools gültig).
+    thread_local const WorkStealingPool* t_pool = nullptr;
+    thread_local unsigned t_index = 0;
+
+} // anonymer Namespace
+
+
+WorkStealingPool::WorkStealingPool(unsigned threads, const std::string& name) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        workers_.emplace_back(&WorkStealingPool::worker_loop, this, i, name + " " + std::to_string(i + 1));
+    }
+}
+
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+
+void WorkStealingPool::submit(Task task) {
+    unsigned index = (t_pool == this)
+        ? t_index
+        : next_queue_.fetch_add(1, std::memory_order_relaxed) % size();
+
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+        queued_.fetch_add(1);
+    }
+    {
+        // Leere Sperre verhindert verlorene Weckrufe
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    wake_.notify_one();
+}
+
+
+void WorkStealingPool::wait_idle() {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    idle_.wait(lock, [this] { return pending_.load() == 0; });
+}
+
+
+bool WorkStealingPool::pop_local(unsigned index, Task& task) {
+    Queue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queued_.fetch_sub(1);
+    return true;
+}
+
+
+bool WorkStealingPool::steal(unsigned thief, Task& task) {
+    for (unsigned offset = 1; offset < size(); offset++) {
+        Queue& queue = *queues_[(thief + offset) % size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void WorkStealingPool::worker_loop(unsigned index, std::string name) {
+    t_pool = this;
+    t_index = index;
+    trace_set_thread_name(name);
+
+    for (;;) {
+        Task task;
+        if (pop_local(index, task) || steal(index, task)) {
+            task();
+            if (pending_.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                idle_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        if (stop_) {
+            return;
+        }
+        // Aufgaben können zwischen Suche und Sperre eingereiht worden sein
+        wake_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+        if (stop_) {
+            return;
+        }
+    }
+}
@@ -46,6 +46,54 @@ TEST_CASE("extract_defines - Syntaxfehler") {
     REQUIRE(report.has_errors());
 }
 
+TEST_CASE("extract_defines - Verweise werden einmalig aufgelöst") {
+    PreprocReport report;
+
+    auto lines = make_lines(
+        "\\define{TITEL}{AUTOR: BUCH}\n"
+        "\\define{AUTOR}{VORNAME Arik}\n"
+        "\\define{VORNAME}{Fatih}\n"
+        "\\define{BUCH}{Band BAND}\n"
+        "\\define{BAND}{2}");
+    auto defines = extract_defines(lines, report);
+
+    REQUIRE(defines["TITEL"] == "Fatih Arik: Band 2");
+    REQUIRE(defines["AUTOR"] == "Fatih Arik");
+    REQUIRE_FALSE(report.has_errors());
+}
+
+TEST_CASE("extract_defines - zyklische Defines bleiben als Text stehen") {
+    PreprocReport report;
+
+    auto lines = make_lines(
+        "\\define{A}{x B}\n"
+        "\\define{B}{y A}\n"
+        "\\define{C}{C+1}");
+    auto defines = extract_defines(lines, report);
+
+    // Zyklen sind nur Warnungen; abgearbeitet wird nach Namen, der Zyklus schließt sich bei A
+    REQUIRE_FALSE(report.has_errors());
+    REQUIRE(defines["A"] == "x y A");
+    REQUIRE(defines["B"] == "y A");
+    REQUIRE(defines["C"] == "C+1");
+}
+
+TEST_CASE("extract_defines - lange Ketten ohne Rekursion") {
+    PreprocReport report;
+
+    const int length = 50000;
+    std::string text;
+    for (int i = 1; i < length; i++) {
+        text += "\\define{A" + std::to_string(i) + "}{A" + std::to_string(i + 1) + "}\n";
+    }
+    text += "\\define{A" + std::to_string(length) + "}{Ende}";
+    auto defines = extract_defines(make_lines(text), report);
+
+    REQUIRE_FALSE(report.has_errors());
+    REQUIRE(defines["A1"] == "Ende");
+    REQUIRE(defines["A" + std::to_string(length / 2)] == "Ende");
+}
+
 TEST_CASE("remove_defines entfernt Define-Zeilen") {
     std::string input = "\\define{DEBUG}\n" 
                         "Text\n"
@@ -0,0 +1,148 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "file_provider.h"
+#include "file_utils.h"
+#include "test_helper.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+TEST_CASE("save_to_file - identischer Inhalt wird nicht neu geschrieben") {
+    auto path = std::filesystem::temp_directory_path() / "latexprepro_test_save.tex";
+    std::filesystem::remove(path);
+
+    auto lines = make_lines("Zeile 1\nZeile 2");
+
+    REQUIRE(save_to_file(path.string(), lines) == SaveResult::Written);
+    REQUIRE(save_to_file(path.string(), lines) == SaveResult::Unchanged);
+
+    // Gleiche Länge, anderer Inhalt
+    auto changed = make_lines("Zeile 1\nZeile 3");
+    REQUIRE(save_to_file(path.string(), changed) == SaveResult::Written);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("save_to_file - Schreibfehler beim Schließen wird gemeldet") {
+    // /dev/full lässt sich öffnen, jeder Schreibzugriff scheitert mit ENOSPC
+    if (!std::filesystem::exists("/dev/full")) {
+        return;
+    }
+    REQUIRE(save_to_file("/dev/full", make_lines("Zeile 1")) == SaveResult::Failed);
+}
+
+TEST_CASE("save_to_file - Source-Map fasst zusammenhängende Zeilen zusammen") {
+    auto path = std::filesystem::temp_directory_path() / "latexprepro_test_map.tex";
+
+    std::vector<SourceLine> lines = {
+        { "a", "main.tex", 1 },
+        { "b", "main.tex", 2 },
+        { "c", "kapitel.tex", 1 },
+        { "d", "kapitel.tex", 2 },
+        { "e", "main.tex", 4 }
+    };
+
+    SourceMap map;
+    save_to_file(path.string(), lines, &map);
+
+    REQUIRE(map.files().size() == 2);
+    REQUIRE(map.ranges().size() == 3);
+    REQUIRE(map.lookup(4)->file == "kapitel.tex");
+    REQUIRE(map.lookup(4)->line == 2);
+    REQUIRE(map.lookup(5)->file == "main.tex");
+    REQUIRE(map.lookup(5)->line == 4);
+    REQUIRE_FALSE(map.lookup(6).has_value());
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("SourceMap - Zeile mit Zeilenumbruch belegt mehrere Ausgabezeilen") {
+    SourceMap map;
+    map.add({ "a", "main.tex", 1 });
+    map.add({ "b\nc\nd", "main.tex", 2 });
+    map.add({ "e", "main.tex", 3 });
+
+    REQUIRE(map.lookup(2)->line == 2);
+    REQUIRE(map.lookup(4)->line == 2);
+    REQUIRE(map.lookup(5)->line == 3);
+    REQUIRE_FALSE(map.lookup(6).has_value());
+}
+
+TEST_CASE("read_files_batch - Inhalt wie beim einzelnen Lesen") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "latexprepro_test_batch";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::vector<std::string> names;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 100; i++) {
+        // Größen von leer bis über mehrere Seiten
+        std::string content(static_cast<size_t>(i) * 997, static_cast<char>('a' + i % 26));
+        fs::path path = dir / ("datei" + std::to_string(i) + ".tex");
+        std::ofstream(path, std::ios::binary) << content;
+        names.push_back(path.string());
+        expected.push_back(content);
+    }
+    names.push_back((dir / "fehlt.tex").string());
+
+    auto contents = read_files_batch(names);
+
+    REQUIRE(contents.size() == names.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        REQUIRE(contents[i].has_value());
+        REQUIRE(*contents[i] == expected[i]);
+    }
+    REQUIRE_FALSE(contents.back().has_value());
+
+    // Ein Leser (und Ring) für mehrere Stapel
+    std::unique_ptr<BatchReader> reader = disk_file_provider().batch_reader();
+    for (int round = 0; round < 3; round++) {
+        REQUIRE(reader->read(names) == contents);
+        REQUIRE(reader->read({ names[5] }) == std::vector<std::optional<std::string>>{ expected[5] });
+    }
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("write_dependency_file - make-Regel mit leeren Regeln je Datei") {
+    auto path = std::filesystem::temp_directory_path() / "latexprepro_test_deps.d";
+
+    REQUIRE(write_dependency_file(path.string(), "out.tex", { "main.tex", "mein kapitel.tex", "$x.tex" }));
+
+    std::ifstream in(path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    REQUIRE(buffer.str() ==
+        "out.tex: main.tex \\\n"
+        " mein\\ kapitel.tex \\\n"
+        " $$x.tex\n"
+        "\n"
+        "mein\\ kapitel.tex:\n"
+        "\n"
+        "$$x.tex:\n");
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("write_dependency_file - Maskierung wie gcc -MT") {
+    auto path = std::filesystem::temp_directory_path() / "latexprepro_test_deps_escape.d";
+
+    // Leerzeichen, '$' und '#', ohne und mit Backslash davor
+    REQUIRE(write_dependency_file(path.string(), "out.tex", { "main.tex", "a b$c#d.tex", "x\\ y\\#z.tex" }));
+
+    std::ifstream in(path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    REQUIRE(buffer.str() ==
+        "out.tex: main.tex \\\n"
+        " a\\ b$$c\\#d.tex \\\n"
+        " x\\\\\\ y\\\\\\#z.tex\n"
+        "\n"
+        "a\\ b$$c\\#d.tex:\n"
+        "\n"
+        "x\\\\\\ y\\\\\\#z.tex:\n");
+
+    std::filesystem::remove(path);
+}
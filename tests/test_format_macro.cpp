@@ -17,3 +17,177 @@ TEST_CASE("Formatmakro ignoriert echtes LaTeX") {
     REQUIRE(out[0].line == "\\frac{1}{2}");
     REQUIRE_FALSE(report.has_errors());
 }
+
+TEST_CASE("Formatmakro - identische Aufrufe aus dem Cache") {
+    PreprocReport report;
+    ExpansionCache cache;
+
+    auto lines = make_lines("\\sqrt{x} und \\sqrt{x}\n\\sqrt{x}");
+
+    macro_spec spec{
+        "\\sqrt", 1, "\\sqrt{__0__}"
+    };
+
+    auto out = simplify_macro_spec(lines, spec, report, &cache);
+
+    REQUIRE(join_lines(out) == "\\sqrt{x} und \\sqrt{x}\n\\sqrt{x}\n");
+    REQUIRE(cache.misses() == 1);
+    REQUIRE(cache.hits() == 2);
+    REQUIRE_FALSE(report.has_errors());
+}
+
+TEST_CASE("ExpansionCache - verdrängt den ältesten Eintrag") {
+    ExpansionCache cache(2);
+
+    cache.insert("a", "1");
+    cache.insert("b", "2");
+    REQUIRE(cache.find("a") != nullptr);   // "a" zuletzt verwendet
+    cache.insert("c", "3");                // verdrängt "b"
+
+    REQUIRE(cache.find("b") == nullptr);
+    REQUIRE(*cache.find("a") == "1");
+    REQUIRE(*cache.find("c") == "3");
+    REQUIRE(cache.evictions() == 1);
+}
+
+TEST_CASE("Formatmakro - exponentielles Wachstum stößt an das Zeilenlimit") {
+    PreprocReport report;
+    ExpansionLimits limits;
+    limits.max_line_bytes = 4096;
+    ExpansionBudget budget(limits);
+
+    // Jede Ebene vervierfacht die Ausgabe: 4^12 Bytes ohne Limit
+    std::string input = "x";
+    for (int i = 0; i < 12; i++) {
+        input = "\\dup{" + input + "}";
+    }
+    auto lines = make_lines(input);
+
+    macro_spec spec{
+        "\\dup", 1, "__0____0____0____0__"
+    };
+
+    auto out = simplify_macro_spec(lines, spec, report, nullptr, &budget);
+
+    REQUIRE(report.errors.size() == 1);
+    REQUIRE(out[0].line.size() <= limits.max_line_bytes);
+}
+
+TEST_CASE("Formatmakro - Verschachtelungstiefe ist begrenzt") {
+    PreprocReport report;
+    ExpansionLimits limits;
+    limits.max_depth = 2;
+    ExpansionBudget budget(limits);
+
+    auto lines = make_lines("\\sqrt{\\sqrt{\\sqrt{\\sqrt{x}}}}");
+
+    macro_spec spec{
+        "\\sqrt", 1, "\\sqrt{__0__}"
+    };
+
+    simplify_macro_spec(lines, spec, report, nullptr, &budget);
+
+    REQUIRE(report.errors.size() == 1);
+    REQUIRE(report.errors[0].message.find("Verschachtelungstiefe") != std::string::npos);
+}
+
+TEST_CASE("Formatmakro - Dokumentlimit bricht die Expansion ab") {
+    PreprocReport report;
+    ExpansionLimits limits;
+    limits.max_document_bytes = 16;
+    ExpansionBudget budget(limits, 10);
+
+    auto lines = make_lines("\\big{a}\n\\big{b}\n\\big{c}");
+
+    macro_spec spec{
+        "\\big", 1, "__0__0123456789"
+    };
+
+    auto out = simplify_macro_spec(lines, spec, report, nullptr, &budget);
+
+    REQUIRE(budget.exhausted());
+    REQUIRE(report.errors.size() == 1);
+    REQUIRE(out[2].line == "\\big{c}");
+}
+
+TEST_CASE("ExpansionBudget - Abbruch wird nur einmal gemeldet") {
+    PreprocReport report;
+    ExpansionLimits limits;
+    limits.max_document_bytes = 16;
+    ExpansionBudget budget(limits, 10);
+    SourceLine sl{ "x", "test.tex", 1 };
+
+    REQUIRE_FALSE(budget.add_document_bytes(10, sl, report));
+    REQUIRE(budget.exhausted());
+
+    // Weitere Buchungen und Zeitprüfungen melden den Abbruch nicht erneut
+    REQUIRE_FALSE(budget.add_document_bytes(-8, sl, report));
+    REQUIRE_FALSE(budget.check_deadline(sl, report));
+    REQUIRE(report.errors.size() == 1);
+}
+
+TEST_CASE("Steuerwörter - Formatstrings, die neue Steuerwörter bilden können") {
+    std::unordered_set<std::string> words;
+    collect_control_words("$\\frac{1,2}$ \\\\log{x} \\", words);
+    REQUIRE(words == std::unordered_set<std::string>{ "\\frac", "\\log", "\\" });
+
+    REQUIRE_FALSE(may_form_control_words("\\frac{__0__}{__1__}"));
+    REQUIRE_FALSE(may_form_control_words("\\pow{__0__}^{__1__}"));
+    REQUIRE(may_form_control_words("ac{__0__}"));     // "\fr" davor
+    REQUIRE(may_form_control_words("{__0__}\\fr"));   // "ac{" dahinter
+    REQUIRE(may_form_control_words("{\\fr__0__}"));   // Argument "ac"
+    REQUIRE(may_form_control_words("{__0__ac}"));     // Argument endet mit "\fr"
+    REQUIRE(may_form_control_words(""));              // "\fr\foo{}ac" wird "\frac"
+}
+
+TEST_CASE("FormatProgram - Literale und Platzhalter") {
+    FormatProgram program = FormatProgram::compile("\\frac{__0__}{__1__}__1__", 2);
+    std::vector<std::string> args{ "a", "bc" };
+
+    REQUIRE(program.compiled());
+    REQUIRE(program.run(args) == "\\frac{a}{bc}bc");
+    REQUIRE(program.output_size(args) == program.run(args).size());
+
+    // Kein Platzhalter: Index zu groß, führende Null, unvollständig
+    REQUIRE(FormatProgram::compile("__2__ __01__ __0_", 2).run(args) == "__2__ __01__ __0_");
+    REQUIRE(FormatProgram::compile("___0___", 1).run({ "x" }) == "_x_");
+
+    // Eingesetzte Argumente werden nicht erneut ersetzt
+    REQUIRE(apply_format("__0__|__1__", { "__1__", "b" }) == "__1__|b");
+
+    REQUIRE_FALSE(FormatProgram().compiled());
+}
+
+TEST_CASE("Formatmakro - Argumente über mehrere Zeilen") {
+    PreprocReport report;
+    auto lines = make_lines(
+        "$\\frac{1,\n"
+        "  \\frac{2,3}}$ Text\n"
+        "\n"
+        "\\frac{offen,\n"
+        "\n"
+        "Ende");
+
+    REQUIRE(find_closing_brace(lines, { 0, 6 })->line == 1);
+    REQUIRE_FALSE(find_closing_brace(lines, { 3, 5 }));   // Leerzeile beendet die Suche
+
+    std::vector<JoinedLine> joined;
+    auto merged = join_multiline_calls(lines, { "\\frac" }, joined);
+    REQUIRE(merged.size() == 5);
+    REQUIRE(joined.size() == 1);
+
+    macro_spec spec{
+        "\\frac", 2, "\\frac{__0__}{__1__}"
+    };
+    auto out = split_joined_lines(simplify_macro_spec(merged, spec, report), joined);
+
+    REQUIRE(out.size() == lines.size());
+    REQUIRE(out[0].line == "$\\frac{1}{");
+    REQUIRE(out[1].line == "  \\frac{2}{3}}$ Text");
+    REQUIRE(out[1].line_nr == 2);
+    REQUIRE(out[5].line_nr == 6);
+
+    // Nicht geschlossener Aufruf: Fehler in seiner Zeile
+    REQUIRE(report.errors.size() == 1);
+    REQUIRE(report.errors[0].line == 4);
+}
@@ -1,9 +1,16 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "error_collector.h"
+#include "file_utils.h"
+#include "include_resolver.h"
 #include "preprocessor.h"
 #include "test_helper.h"
 
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_set>
+
 
 TEST_CASE("process_include - zyklisches Include") {
     PreprocReport report;
@@ -15,3 +22,431 @@ TEST_CASE("process_include - zyklisches Include") {
 
     REQUIRE(report.has_errors());
 }
+
+
+TEST_CASE("resolve_includes - verworfener ifdef-Zweig wird nicht gelesen") {
+    PreprocReport report;
+    auto lines = make_lines(
+        "\\ifdef{APPENDIX}\n"
+        "\\include{gibt_es_nicht.tex}\n"
+        "\\endif\n");
+
+    auto result = resolve_includes(lines, report);
+
+    REQUIRE_FALSE(report.has_errors());
+    REQUIRE(result.size() == 3);
+}
+
+TEST_CASE("resolve_includes - Define aus eingebundener Datei aktiviert Zweig") {
+    PreprocReport report;
+    // include_content.tex enthält \define{KEY}
+    auto lines = make_lines(
+        "\\include{../latex_docs/include_content.tex}\n"
+        "\\ifdef{KEY}\n"
+        "\\include{gibt_es_nicht.tex}\n"
+        "\\endif\n");
+
+    auto result = resolve_includes(lines, report);
+
+    REQUIRE(report.errors.size() == 1);
+    REQUIRE(report.errors[0].line == 3);
+}
+
+TEST_CASE("resolve_includes - Dateien aus dem Speicher") {
+    PreprocReport report;
+    MemoryFileProvider files;
+    files.add("kapitel.tex", "\\define{KAPITEL}\nInhalt\n");
+
+    auto lines = make_lines(
+        "\\include{kapitel.tex}\n"
+        "\\ifdef{KAPITEL}\n"
+        "\\include{anhang.tex}\n"
+        "\\endif\n");
+
+    IncludeOptions options;
+    options.file_provider = &files;
+    auto result = resolve_includes(lines, report, true, options);
+
+    // anhang.tex fehlt im Speicher → genau ein Fehler, kein Zugriff auf die Festplatte
+    REQUIRE(report.errors.size() == 1);
+    REQUIRE(report.errors[0].line == 3);
+    REQUIRE(result[1].line == "Inhalt");
+    REQUIRE(result[1].file == "kapitel.tex");
+    REQUIRE(result[1].line_nr == 2);
+}
+
+TEST_CASE("resolve_includes - meldet die Pfade fehlender Includes") {
+    MemoryFileProvider files;
+    files.add("buch/vorhanden.tex", "");   // existiert, ist aber leer
+
+    auto lines = make_lines(
+        "\\include{kapitel.tex}\n"
+        "\\include{vorhanden.tex}\n", "buch/main.tex");
+
+    std::vector<std::string> missing;
+    IncludeOptions options;
+    options.file_provider = &files;
+    options.search_paths = { "vorlagen" };
+    options.missing_files = &missing;
+
+    PreprocReport report;
+    resolve_includes(lines, report, true, options);
+
+    // Nicht gefunden → alle Suchorte; gefunden, aber nicht lesbar → der gefundene Pfad
+    REQUIRE(report.errors.size() == 2);
+    REQUIRE(missing == std::vector<std::string>{
+        "buch/kapitel.tex", "kapitel.tex", "vorlagen/kapitel.tex", "buch/vorhanden.tex" });
+
+    // Datei angelegt → nichts fehlt mehr
+    files.add("vorlagen/kapitel.tex", "Inhalt\n");
+    files.add("buch/vorhanden.tex", "Text\n");
+    PreprocReport second;
+    resolve_includes(lines, second, true, options);
+    REQUIRE_FALSE(second.has_errors());
+    REQUIRE(missing.empty());
+}
+
+TEST_CASE("resolve_includes - Overlay bevorzugt die obere Quelle") {
+    PreprocReport report;
+    MemoryFileProvider upper;
+    MemoryFileProvider lower;
+    upper.add("a.tex", "oben");
+    lower.add("a.tex", "unten");
+    lower.add("b.tex", "nur unten");
+    OverlayFileProvider overlay(upper, lower);
+
+    auto lines = make_lines("\\include{a.tex}\n\\include{b.tex}\n");
+    IncludeOptions options;
+    options.file_provider = &overlay;
+    auto result = resolve_includes(lines, report, true, options);
+
+    REQUIRE_FALSE(report.has_errors());
+    REQUIRE(join_lines(result) == "oben\nnur unten\n");
+}
+
+TEST_CASE("resolve_includes - paralleles und gebündeltes Einlesen ergeben dieselbe Reihenfolge") {
+    MemoryFileProvider files;
+    std::string book;
+    for (int c = 0; c < 20; c++) {
+        std::string chapter = "kapitel" + std::to_string(c) + ".tex";
+        std::string content = "Kapitel " + std::to_string(c) + "\n";
+        for (int s = 0; s < 5; s++) {
+            std::string section = "abschnitt" + std::to_string(c) + "_" + std::to_string(s) + ".tex";
+            files.add(section, "Abschnitt " + std::to_string(s) + "\n\\include{gemeinsam.tex}\n");
+            content += "\\include{" + section + "}\n";
+        }
+        book += "\\include{" + chapter + "}\n";
+        files.add(chapter, content);
+    }
+    files.add("gemeinsam.tex", "gemeinsam\n");
+    // Zyklus über zwei Dateien
+    files.add("a.tex", "\\include{b.tex}\n");
+    files.add("b.tex", "\\include{a.tex}\n");
+    book += "\\include{a.tex}\n";
+
+    auto lines = make_lines(book);
+
+    IncludeOptions options;
+    options.file_provider = &files;
+
+    PreprocReport sequential_report;
+    auto sequential = resolve_includes(lines, sequential_report, true, options);
+
+    PreprocReport parallel_report;
+    FileCache cache;
+    options.file_cache = &cache;
+    options.jobs = 4;
+    auto parallel = resolve_includes(lines, parallel_report, true, options);
+
+    REQUIRE(parallel == sequential);
+    REQUIRE(parallel_report.errors.size() == 1);
+    REQUIRE(sequential_report.errors.size() == 1);
+    REQUIRE(cache.size() == 20 * 5 + 20 + 1 + 2);
+
+    PreprocReport batched_report;
+    FileCache batched_cache;
+    options.file_cache = &batched_cache;
+    options.batch_read = true;
+    auto batched = resolve_includes(lines, batched_report, true, options);
+
+    REQUIRE(batched == sequential);
+    REQUIRE(batched_report.errors.size() == 1);
+    REQUIRE(batched_cache.size() == cache.size());
+}
+
+namespace {
+
+    // Zählt Existenzprüfungen, um den Auflösungs-Cache zu prüfen
+    class CountingProvider : public MemoryFileProvider {
+    public:
+        bool exists(const std::string& name) const override {
+            lookups++;
+            return MemoryFileProvider::exists(name);
+        }
+        mutable int lookups = 0;
+    };
+
+
+    // Merkt sich gelesene Dateien (threadsicher, auch für Vorablesen)
+    class RecordingProvider : public MemoryFileProvider {
+    public:
+        std::optional<std::string> read(const std::string& name) const override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            read_names.insert(name);
+            return MemoryFileProvider::read(name);
+        }
+        mutable std::unordered_set<std::string> read_names;
+
+    private:
+        mutable std::mutex mutex_;
+    };
+
+}
+
+TEST_CASE("resolve_includes - relativ zur einbindenden Datei und über Suchpfade") {
+    PreprocReport report;
+    MemoryFileProvider files;
+    files.add("buch/kapitel.tex", "\\include{abschnitt.tex}\n\\include{vorlage.tex}\n");
+    files.add("buch/abschnitt.tex", "Abschnitt");
+    files.add("vorlagen/vorlage.tex", "Vorlage");
+
+    IncludeOptions options;
+    options.file_provider = &files;
+    options.search_paths = { "vorlagen" };
+
+    auto lines = make_lines("\\include{buch/kapitel.tex}\n");
+    auto result = resolve_includes(lines, report, true, options);
+
+    REQUIRE_FALSE(report.has_errors());
+    REQUIRE(join_lines(result) == "Abschnitt\nVorlage\n");
+    REQUIRE(result[0].file == "buch/abschnitt.tex");
+    REQUIRE(result[1].file == "vorlagen/vorlage.tex");
+}
+
+TEST_CASE("IncludeResolver - wiederholte Auflösung ohne erneute Prüfung") {
+    CountingProvider files;
+    files.add("vorlagen/gemeinsam.tex", "x");
+    IncludeResolver resolver(files, { "vorlagen" });
+
+    REQUIRE(resolver.resolve("gemeinsam.tex", "buch/a.tex")->path == "vorlagen/gemeinsam.tex");
+    int lookups = files.lookups;
+    REQUIRE(resolver.resolve("gemeinsam.tex", "buch/b.tex")->path == "vorlagen/gemeinsam.tex");
+    REQUIRE_FALSE(resolver.resolve("fehlt.tex", "buch/a.tex"));
+    REQUIRE_FALSE(resolver.resolve("fehlt.tex", "buch/b.tex"));
+
+    REQUIRE(files.lookups == lookups + 3);   // nur der erste Fehlschlag prüft (3 Kandidaten)
+    REQUIRE(resolver.hits() == 2);
+}
+
+TEST_CASE("resolve_includes - Hardlink wird als dieselbe Datei erkannt") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "latexprepro_test_inode";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "sub");
+
+    std::ofstream(dir / "a.tex") << "Inhalt\n";
+    std::error_code ec;
+    fs::create_hard_link(dir / "a.tex", dir / "sub" / "b.tex", ec);
+    if (ec) {
+        WARN("Hardlinks werden nicht unterstützt");
+        return;
+    }
+
+    // Zwei Schreibweisen und ein Hardlink → eine Datei im Cache
+    std::string base = dir.generic_string();
+    auto lines = make_lines(
+        "\\include{" + base + "/a.tex}\n"
+        "\\include{" + base + "/sub/../a.tex}\n"
+        "\\include{" + base + "/sub/b.tex}\n");
+
+    PreprocReport report;
+    FileCache cache;
+    IncludeOptions options;
+    options.file_cache = &cache;
+    auto result = resolve_includes(lines, report, true, options);
+
+    REQUIRE_FALSE(report.has_errors());
+    REQUIRE(result.size() == 3);
+    REQUIRE(cache.size() == 1);
+    REQUIRE(result[2].file == base + "/sub/b.tex");   // Schreibweise bleibt erhalten
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("resolve_includes - relative Includes folgen der geschriebenen Schreibweise") {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "latexprepro_test_spelling";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "a");
+    fs::create_directories(dir / "b");
+
+    std::ofstream(dir / "a" / "teil.tex") << "\\include{nachbar.tex}\n";
+    std::ofstream(dir / "a" / "nachbar.tex") << "Nachbar A\n";
+    std::ofstream(dir / "b" / "nachbar.tex") << "Nachbar B\n";
+    std::error_code ec;
+    fs::create_hard_link(dir / "a" / "teil.tex", dir / "b" / "teil.tex", ec);
+    if (ec) {
+        WARN("Hardlinks werden nicht unterstützt");
+        return;
+    }
+
+    std::string base = dir.generic_string();
+    auto lines = make_lines(
+        "\\include{" + base + "/a/teil.tex}\n"
+        "\\include{" + base + "/b/teil.tex}\n");
+
+    for (unsigned jobs : { 1u, 4u }) {
+        PreprocReport report;
+        FileCache cache;
+        IncludeOptions options;
+        options.file_cache = &cache;
+        options.jobs = jobs;
+        auto result = resolve_includes(lines, report, true, options);
+
+        REQUIRE_FALSE(report.has_errors());
+        REQUIRE(join_lines(result) == "Nachbar A\nNachbar B\n");
+        REQUIRE(result[1].file == base + "/b/nachbar.tex");
+    }
+
+    fs::remove_all(dir);
+}
+
+TEST_CASE("collect_include_dependencies - nur der Include-Graph") {
+    MemoryFileProvider files;
+    files.add("main.tex", "\\include{a.tex}\n\\ifdef{NIE}\n\\include{b.tex}\n\\endif\n\\include{a.tex}\n\\include{fehlt.tex}\n");
+    files.add("a.tex", "\\include{c.tex}\n");
+    files.add("b.tex", "\\include{main.tex}\n");
+    files.add("c.tex", "\\define{X}{\\include{nicht.tex}}\n");
+
+    PreprocReport report;
+    IncludeOptions options;
+    options.file_provider = &files;
+    auto dependencies = collect_include_dependencies(split_lines(*files.read("main.tex"), "main.tex"), report, options);
+
+    // Verworfene Zweige zählen mit, Eingabedatei und Dubletten nicht
+    REQUIRE(dependencies == std::vector<std::string>{ "a.tex", "c.tex", "b.tex" });
+    REQUIRE(report.errors.size() == 1);
+    REQUIRE(report.errors[0].line == 6);
+}
+
+TEST_CASE("resolve_includes - Datei-Cache enthält nur eingefügte Dateien") {
+    MemoryFileProvider files;
+    files.add("a.tex", "A\n");
+    files.add("b.tex", "B\n");
+
+    PreprocReport report;
+    FileCache cache;
+    IncludeOptions options;
+    options.file_provider = &files;
+    options.file_cache = &cache;
+    resolve_includes(make_lines("\\include{a.tex}\n\\include{b.tex}\n"), report, true, options);
+    REQUIRE(cache.size() == 2);
+
+    // \include{b.tex} entfernt → b.tex fällt aus dem Cache (und der Überwachung)
+    resolve_includes(make_lines("\\include{a.tex}\n"), report, true, options);
+    REQUIRE(cache.size() == 1);
+    REQUIRE(cache.contains("a.tex"));
+}
+
+TEST_CASE("resolve_includes - Vorablesen öffnet keine verworfenen Zweige") {
+    RecordingProvider files;
+    files.add("kapitel.tex", "Kapitel\n\\ifdef{NIE}\n\\include{geheim2.tex}\n\\endif\n");
+    files.add("geheim.tex", "geheim\n");
+    files.add("geheim2.tex", "geheim\n");
+    files.add("anhang.tex", "Anhang\n");
+
+    auto lines = make_lines(
+        "\\ifdef{NIE}\n"
+        "\\include{geheim.tex}\n"
+        "\\else\n"
+        "\\include{anhang.tex}\n"
+        "\\endif\n"
+        "\\include{kapitel.tex}\n");
+
+    for (bool batch_read : { false, true }) {
+        files.read_names.clear();
+        PreprocReport report;
+        IncludeOptions options;
+        options.file_provider = &files;
+        options.jobs = 4;
+        options.batch_read = batch_read;
+        auto result = resolve_includes(lines, report, true, options);
+
+        REQUIRE_FALSE(report.has_errors());
+        REQUIRE(files.read_names == std::unordered_set<std::string>{ "kapitel.tex", "anhang.tex" });
+    }
+}
+
+TEST_CASE("resolve_includes - Vorablesen folgt Blöcken über Dateigrenzen") {
+    RecordingProvider files;
+    files.add("oeffnet.tex", "\\ifdef{NIE}\n");
+    files.add("umschalten.tex", "\\else\n");
+    files.add("teil.tex", "\\include{oeffnet.tex}\n\\include{geheim.tex}\n");
+    files.add("geheim.tex", "geheim\n");
+    files.add("kapitel.tex", "Kapitel\n");
+
+    // Block beginnt in der eingebundenen Datei und endet im Einbindenden,
+    // Zweig wechselt in der eingebundenen Datei, Block beginnt eine Ebene tiefer
+    auto documents = {
+        "\\include{oeffnet.tex}\n\\include{geheim.tex}\n\\endif\n\\include{kapitel.tex}\n",
+        "\\define{JA}\n\\ifdef{JA}\n\\include{umschalten.tex}\n\\include{geheim.tex}\n\\endif\n\\include{kapitel.tex}\n",
+        "\\include{teil.tex}\n\\endif\n\\include{kapitel.tex}\n",
+    };
+
+    for (const char* document : documents) {
+        for (bool batch_read : { false, true }) {
+            files.read_names.clear();
+            PreprocReport report;
+            IncludeOptions options;
+            options.file_provider = &files;
+            options.jobs = 4;
+            options.batch_read = batch_read;
+            auto result = resolve_includes(make_lines(document), report, true, options);
+
+            REQUIRE_FALSE(report.has_errors());
+            REQUIRE_FALSE(files.read_names.contains("geheim.tex"));
+            REQUIRE(files.read_names.contains("kapitel.tex"));
+        }
+    }
+}
+
+TEST_CASE("resolve_includes - verbatim-Inhalte werden nicht ausgewertet") {
+    RecordingProvider files;
+    files.add("chapter.tex", "Kapitel\n");
+    files.add("listing.tex", "Listing\n");
+
+    // \include im Listing bleibt Text, ein \ifdef ohne \endif darin verschluckt keine Includes
+    auto lines = make_lines(
+        "\\begin{verbatim}\n"
+        "\\include{listing.tex}\n"
+        "\\ifdef{NIE}\n"
+        "\\define{NIE}\n"
+        "\\end{verbatim}\n"
+        "\\include{chapter.tex}\n");
+
+    for (bool batch_read : { false, true }) {
+        files.read_names.clear();
+        PreprocReport report;
+        IncludeOptions options;
+        options.file_provider = &files;
+        options.jobs = 4;
+        options.batch_read = batch_read;
+        auto result = resolve_includes(lines, report, true, options);
+
+        REQUIRE_FALSE(report.has_errors());
+        REQUIRE(join_lines(result) ==
+            "\\begin{verbatim}\n"
+            "\\include{listing.tex}\n"
+            "\\ifdef{NIE}\n"
+            "\\define{NIE}\n"
+            "\\end{verbatim}\n"
+            "Kapitel\n");
+        REQUIRE(files.read_names == std::unordered_set<std::string>{ "chapter.tex" });
+    }
+
+    PreprocReport report;
+    IncludeOptions options;
+    options.file_provider = &files;
+    REQUIRE(collect_include_dependencies(lines, report, options) == std::vector<std::string>{ "chapter.tex" });
+    REQUIRE(collect_define_keys(lines).empty());
+}
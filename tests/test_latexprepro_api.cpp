@@ -0,0 +1,187 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "file_utils.h"
+#include "latexprepro.h"
+#include "macro_codegen.h"
+#include "protected_regions.h"
+#include "json.hpp"
+
+
+#include <string>
+
+namespace {
+
+    MacroTable make_macros(PreprocReport& report) {
+        auto json = nlohmann::json::parse(R"({
+            "\\frac":    { "type": "format", "arg_count": 2, "replacement": "\\frac{__0__}{__1__}" },
+            "\\define":  { "type": "define" },
+            "\\ifdef":   { "type": "conditional" },
+            "\\include": { "type": "include" }
+        })");
+        return parse_macro_table(json, report);
+    }
+
+}
+
+TEST_CASE("preprocess_text - vollständiger Lauf im Speicher") {
+    PreprocReport load_report;
+    MacroTable macros = make_macros(load_report);
+    REQUIRE_FALSE(load_report.has_errors());
+
+    std::string input =
+        "\\define{DEBUG}\n"
+        "\\ifdef{DEBUG}\n"
+        "$\\frac{1,2}$\n"
+        "\\endif\n";
+
+    PreprocResult result = preprocess_text(input, "main.tex", macros);
+
+    REQUIRE_FALSE(result.report.has_errors());
+    REQUIRE(result.text() == "$\\frac{1}{2}$\n");
+    REQUIRE(result.lines[0].file == "main.tex");
+    REQUIRE(result.lines[0].line_nr == 3);
+}
+
+TEST_CASE("preprocess_text - Kommentare und verbatim bleiben unverändert") {
+    PreprocReport load_report;
+    MacroTable macros = make_macros(load_report);
+
+    std::string input =
+        "\\define{NAME}{Max}\n"
+        "NAME % NAME \\frac{1,2}\n"
+        "\\verb|NAME| 100\\% NAME\n"
+        "\\begin{lstlisting}[title=NAME]\n"
+        "\\define{NAME}{Moritz}\n"
+        "\\ifdef{NAME} \\frac{1,2}\n"
+        "\\end{lstlisting} NAME\n";
+
+    PreprocResult result = preprocess_text(input, "main.tex", macros);
+
+    REQUIRE_FALSE(result.report.has_errors());
+    REQUIRE(result.text() ==
+        "Max % NAME \\frac{1,2}\n"
+        "\\verb|NAME| 100\\% Max\n"
+        "\\begin{lstlisting}[title=Max]\n"
+        "\\define{NAME}{Moritz}\n"
+        "\\ifdef{NAME} \\frac{1,2}\n"
+        "\\end{lstlisting} Max\n");
+}
+
+TEST_CASE("ProtectedRegions - Platzhalter überstehen Umordnen und Vervielfältigen") {
+    ProtectedRegions regions;
+    auto hidden = regions.hide(split_lines("a % eins\nb \x01 % zwei", "main.tex"));
+
+    REQUIRE(regions.size() == 3);
+    REQUIRE(hidden[0].line.find('%') == std::string::npos);
+
+    // Zeilen vertauschen und eine verdoppeln
+    std::vector<SourceLine> changed{ hidden[1], hidden[0], hidden[0] };
+    auto restored = regions.restore(changed);
+
+    REQUIRE(restored[0].line == "b \x01 % zwei");
+    REQUIRE(restored[1].line == "a % eins");
+    REQUIRE(restored[2].line == "a % eins");
+}
+
+TEST_CASE("preprocess_text - Fehler landen im Ergebnisbericht") {
+    PreprocReport load_report;
+    MacroTable macros = make_macros(load_report);
+
+    PreprocResult result = preprocess_text("$\\frac{1}$\n", "main.tex", macros);
+
+    REQUIRE(result.report.has_errors());
+    REQUIRE(result.report.errors[0].file == "main.tex");
+}
+
+TEST_CASE("parse_macro_table - ungültiger Eintrag wird gemeldet") {
+    PreprocReport report;
+    auto json = nlohmann::json::parse(R"({ "\\frac": { "arg_count": 2 } })");
+
+    MacroTable macros = parse_macro_table(json, report);
+
+    REQUIRE(report.has_errors());
+    REQUIRE(macros.empty());
+}
+
+TEST_CASE("MacroLibrary - instanziiert nur verwendete Makros") {
+    MacroLibrary library(nlohmann::json::parse(R"({
+        "\\frac":   { "type": "format", "arg_count": 2, "replacement": "\\frac{__0__}{__1__}" },
+        "\\half":   { "type": "format", "arg_count": 1, "replacement": "\\frac{1,__0__}" },
+        "\\sqrt":   { "type": "format", "arg_count": 1, "replacement": "\\sqrt{__0__}" },
+        "\\kaputt": { "type": "format" },
+        "\\define": { "type": "define" }
+    })"));
+
+    PreprocReport report;
+    MacroTable macros = library.instantiate({ "\\half", "\\begin" }, report);
+
+    // \frac über den Ersatztext von \half, Logikmakros immer
+    REQUIRE(macros.size() == 3);
+    REQUIRE(macros.contains("\\half"));
+    REQUIRE(macros.contains("\\frac"));
+    REQUIRE(macros.contains("\\define"));
+    REQUIRE_FALSE(report.has_errors());
+
+    REQUIRE(library.instantiate_all(report).size() == 4);
+    REQUIRE(report.has_errors());
+}
+
+TEST_CASE("preprocess_lines - Makrosammlung liefert dasselbe wie die Tabelle") {
+    auto json = nlohmann::json::parse(R"({
+        "\\frac":   { "type": "format", "arg_count": 2, "replacement": "\\frac{__0__}{__1__}" },
+        "\\bruch":  { "type": "format", "arg_count": 1, "replacement": "\\frac{1,__0__}" },
+        "\\sqrt":   { "type": "format", "arg_count": 1, "replacement": "\\sqrt{__0__}" },
+        "\\define": { "type": "define" }
+    })");
+    PreprocReport load_report;
+    MacroTable table = parse_macro_table(json, load_report);
+    MacroLibrary library(json);
+
+    // \NAME wird erst durch das Define zu \bruch
+    std::string input =
+        "\\define{NAME}{bruch}\n"
+        "$\\NAME{\\sqrt{2}}$\n";
+
+    PreprocResult from_table = preprocess_text(input, "main.tex", table);
+    PreprocReport report;
+    auto from_library = preprocess_lines(split_lines(input, "main.tex"), library, report);
+
+    REQUIRE_FALSE(report.has_errors());
+    REQUIRE(from_library == from_table.lines);
+    REQUIRE(from_library[0].line == "$\\frac{1}{\\sqrt{2}}$");
+
+    // Eingebaute Tabelle (macro_codegen) verhält sich wie die JSON-Sammlung
+    MacroLibrary builtin(table);
+    REQUIRE(builtin.hash() == hash_macro_table(table));
+    REQUIRE(preprocess_lines(split_lines(input, "main.tex"), builtin, report) == from_library);
+}
+
+TEST_CASE("preprocess_lines - leere Ersetzung bildet neue Steuerwörter") {
+    MacroLibrary library(nlohmann::json::parse(R"({
+        "\\foo":  { "type": "format", "arg_count": 1, "replacement": "" },
+        "\\frac": { "type": "format", "arg_count": 2, "replacement": "\\frac{__0__}{__1__}" }
+    })"));
+
+    // \frac steht nirgends im Text, erst das Entfernen von \foo{} bildet es
+    PreprocReport report;
+    auto lines = preprocess_lines(split_lines("$\\fr\\foo{}ac{1,2}$\n", "main.tex"), library, report);
+
+    REQUIRE_FALSE(report.has_errors());
+    REQUIRE(lines[0].line == "$\\frac{1}{2}$");
+}
+
+TEST_CASE("macro_codegen - erzeugt sortierte, maskierte Tabelle") {
+    PreprocReport report;
+    MacroTable table = parse_macro_table(nlohmann::json::parse(R"({
+        "\\sqrt":   { "type": "format", "arg_count": 1, "replacement": "\\sqrt{__0__}" },
+        "\\quote":  { "type": "format", "arg_count": 1, "replacement": "\"__0__\"\u00e4" },
+        "\\define": { "type": "define" }
+    })"), report);
+
+    std::string code = generate_builtin_macros(table, "makros.json");
+
+    REQUIRE(code.find(R"({ macro_type::Define, "\\define", 0, "" },)") != std::string::npos);
+    REQUIRE(code.find(R"({ macro_type::Format, "\\quote", 1, "\"__0__\"\303\244" },)") != std::string::npos);
+    REQUIRE(code.find("\\\\define") < code.find("\\\\quote"));
+    REQUIRE(code.find("\\\\quote") < code.find("\\\\sqrt"));
+}
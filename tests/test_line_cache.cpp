@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "line_cache.h"
+#include "macro_handler.h"
+#include "test_helper.h"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+TEST_CASE("LineCache - Expansionen überdauern den Lauf") {
+    auto dir = std::filesystem::temp_directory_path() / "latexprepro_test_line_cache";
+    std::filesystem::remove_all(dir);
+
+    std::unordered_map<std::string, dynamic_macro> macros{
+        { "\\frac", { macro_type::Format, "\\frac", 2, "\\frac{__0__}{__1__}", {} } }
+    };
+    std::unordered_map<std::string, std::string> defines;
+    auto lines = make_lines("Text\n\\frac{1,2}\n\\frac{3,4}");
+
+    std::string first_output;
+    {
+        PreprocReport report;
+        LineCache cache;
+        REQUIRE(cache.load(dir.string(), hash_macro_table(macros)));
+
+        MacroOptions options;
+        options.line_cache = &cache;
+        first_output = join_lines(apply_all_macros(lines, macros, defines, report, options));
+
+        REQUIRE(report.stats.line_cache.misses == 2);
+        REQUIRE(cache.save());
+    }
+
+    PreprocReport report;
+    LineCache cache;
+    REQUIRE(cache.load(dir.string(), hash_macro_table(macros)));
+    REQUIRE(cache.size() == 2);
+
+    MacroOptions options;
+    options.line_cache = &cache;
+    auto result = apply_all_macros(lines, macros, defines, report, options);
+
+    REQUIRE(join_lines(result) == first_output);
+    REQUIRE(first_output == "Text\n\\frac{1}{2}\n\\frac{3}{4}\n");
+    REQUIRE(report.stats.line_cache.hits == 2);
+    REQUIRE(report.stats.line_cache.misses == 0);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("LineCache - trim behält zuerst die verwendeten Einträge") {
+    LineCache cache;
+    cache.insert("a", "A");
+    cache.insert("b", "B");
+    cache.trim();
+    cache.insert("c", "C");
+    REQUIRE(cache.find("a") != nullptr);
+
+    cache.trim(2);
+
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.find("a") != nullptr);
+    REQUIRE(cache.find("c") != nullptr);
+    REQUIRE(cache.find("b") == nullptr);
+}
+
+TEST_CASE("LineCache - Treffer zählen gegen das Dokumentlimit") {
+    std::unordered_map<std::string, dynamic_macro> macros{
+        { "\\frac", { macro_type::Format, "\\frac", 2, "\\frac{__0__}{__1__}", {} } }
+    };
+    std::unordered_map<std::string, std::string> defines;
+    auto lines = make_lines("\\frac{1,2}");
+
+    LineCache cache;
+    cache.insert("\\frac{1,2}", std::string(1000, 'x'));
+
+    PreprocReport report;
+    MacroOptions options;
+    options.line_cache = &cache;
+    options.limits.max_document_bytes = 100;
+    auto result = apply_all_macros(lines, macros, defines, report, options);
+
+    REQUIRE(report.errors.size() == 1);
+    REQUIRE(result[0].line == "\\frac{1,2}");
+}
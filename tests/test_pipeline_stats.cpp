@@ -0,0 +1,119 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "error_collector.h"
+#include "file_provider.h"
+#include "latexprepro.h"
+#include "macro_handler.h"
+#include "test_helper.h"
+#include "trace.h"
+#include "json.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+TEST_CASE("run_stage - zählt Zeilen und Bytes") {
+    PipelineStats stats;
+    stats.enabled = true;
+
+    auto lines = make_lines("abc\nde");
+
+    auto result = run_stage(stats, "test", lines, [&] {
+        return std::vector<SourceLine>{ lines[0] };
+    });
+
+    REQUIRE(result.size() == 1);
+    REQUIRE(stats.stages.size() == 1);
+    REQUIRE(stats.stages[0].name == "test");
+    REQUIRE(stats.stages[0].in_lines == 2);
+    REQUIRE(stats.stages[0].in_bytes == 7);
+    REQUIRE(stats.stages[0].out_lines == 1);
+    REQUIRE(stats.stages[0].out_bytes == 4);
+}
+
+TEST_CASE("apply_all_macros - Unterschritte je Formatmakro") {
+    PreprocReport report;
+    report.stats.enabled = true;
+
+    std::unordered_map<std::string, dynamic_macro> macros{
+        { "\\sqrt", { macro_type::Format, "\\sqrt", 1, "\\sqrt{__0__}", {} } }
+    };
+    std::unordered_map<std::string, std::string> defines;
+
+    auto lines = make_lines("\\sqrt{2}");
+    auto result = apply_all_macros(lines, macros, defines, report);
+
+    REQUIRE(report.stats.stages.size() == 1);
+    REQUIRE(report.stats.stages[0].name == "simplify_macro_spec \\sqrt");
+    REQUIRE(report.stats.depth == 0);
+}
+
+TEST_CASE("run_stage - deaktivierte Messung erfasst nichts") {
+    PipelineStats stats;
+    auto lines = make_lines("abc");
+
+    run_stage(stats, "test", lines, [&] { return lines; });
+
+    REQUIRE(stats.stages.empty());
+}
+
+TEST_CASE("write_trace - ein Event je Schritt und je Include") {
+    MemoryFileProvider files;
+    files.add("kapitel.tex", "Inhalt\n");
+    files.add("anhang\xE4.tex", "Anhang\n");   // Latin-1, kein gültiges UTF-8
+
+    PreprocOptions options;
+    options.include_options.file_provider = &files;
+
+    trace_enable();
+    PreprocReport load_report;
+    MacroTable macros = parse_macro_table(nlohmann::json::parse(R"({
+        "\\sqrt": { "type": "format", "arg_count": 1, "replacement": "\\sqrt{__0__}" }
+    })"), load_report);
+    PreprocResult result = preprocess_text(
+        "\\include{kapitel.tex}\n"
+        "\\include{anhang\xE4.tex}\n"
+        "$\\sqrt{2}$\n", "main.tex", macros, options);
+    trace_disable();
+
+    auto path = std::filesystem::temp_directory_path() / "latexprepro_test_trace.json";
+    REQUIRE_FALSE(result.report.has_errors());
+    REQUIRE(write_trace(path.string()));
+
+    std::ifstream in(path);
+    nlohmann::json trace = nlohmann::json::parse(in);
+    REQUIRE(trace["displayTimeUnit"] == "ms");
+    REQUIRE(trace["traceEvents"].is_array());
+
+    std::map<std::string, int> stages;
+    std::vector<std::string> includes;
+    for (const auto& event : trace["traceEvents"]) {
+        if (event["ph"] != "X") {
+            continue;
+        }
+        REQUIRE(event.contains("ts"));
+        REQUIRE(event.contains("dur"));
+        REQUIRE(event["pid"] == 1);
+        if (event["cat"] == "stage") {
+            stages[event["name"].get<std::string>()]++;
+        }
+        else if (event["cat"] == "include") {
+            includes.push_back(event["name"].get<std::string>());
+        }
+    }
+
+    REQUIRE(stages == std::map<std::string, int>{
+        { "resolve_includes", 1 },
+        { "hide_protected_regions", 1 },
+        { "line_features", 1 },
+        { "extract_defines", 1 },
+        { "apply_all_macros", 1 },
+        { "simplify_macro_spec \\sqrt", 1 },
+    });
+    // Ungültige Bytes im Dateinamen werden beim Schreiben durch U+FFFD ersetzt
+    REQUIRE(includes == std::vector<std::string>{ "kapitel.tex", "anhang\xEF\xBF\xBD.tex" });
+
+    std::filesystem::remove(path);
+}
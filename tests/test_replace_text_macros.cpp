@@ -1,5 +1,6 @@
 #include <catch2/catch_test_macros.hpp>
 
+#include "line_features.h"
 #include "preprocessor.h"
 #include "test_helper.h"
 
@@ -26,4 +27,70 @@ TEST_CASE("replace_text_macros - Wortgrenzen") {
     auto result = replace_text_macros(lines, defs);
 
     REQUIRE(join_lines(result) == "X NAME1 _NAME NAME_\n");
-}
\ No newline at end of file
+}
+
+TEST_CASE("replace_text_macros - ein Durchlauf, längster Schlüssel zuerst") {
+    auto lines = make_lines("A B A-B C");
+    std::unordered_map<std::string, std::string> defs = {
+        {"A", "B"},
+        {"B", "A"},
+        {"A-B", "X"},
+        {"C", "A-B"}
+    };
+
+    auto result = replace_text_macros(lines, defs);
+
+    // Eingesetzte Werte werden nicht erneut ersetzt
+    REQUIRE(join_lines(result) == "B A X A-B\n");
+}
+TEST_CASE("Zeilenmerkmale - Flags und Wortfilter") {
+    LineFeatures prose = compute_line_features("Nur Text, AUTHOR steht hier.");
+    REQUIRE(prose.has(kLineFeaturesKnown));
+    REQUIRE_FALSE(prose.has(kLineBackslash));
+    REQUIRE_FALSE(prose.has(kLineBrace));
+    REQUIRE(prose.may_contain_words(word_bit("AUTHOR")));
+
+    LineFeatures directive = compute_line_features("  \\ifdef{DEBUG}");
+    REQUIRE(directive.has(kLineDirective));
+    REQUIRE(directive.has(kLineBackslash));
+    REQUIRE(directive.has(kLineBrace));
+
+    REQUIRE_FALSE(compute_line_features("x \\define{A}").has(kLineDirective));
+}
+
+TEST_CASE("Zeilenmerkmale - Schritte schreiben den Merkmalsvektor fort") {
+    auto lines = make_lines("\\define{NAME}{Max}\n\\ifdef{DEBUG}\nGeheim\n\\endif\nHallo NAME\nEnde");
+    std::vector<LineFeatures> features = compute_line_features(lines);
+
+    std::unordered_map<std::string, std::string> defs = {
+        {"NAME", "Max"}
+    };
+    PreprocReport report;
+    auto result = remove_defines(lines, &features);
+    result = process_conditionals(result, defs, report, &features);
+    result = replace_text_macros(result, defs, &features);
+
+    REQUIRE(join_lines(result) == "Hallo Max\nEnde\n");
+    REQUIRE(features.size() == result.size());
+
+    // Geänderte Zeile gilt als nicht ermittelt, unveränderte behalten ihre Merkmale
+    REQUIRE_FALSE(features[0].has(kLineFeaturesKnown));
+    REQUIRE(features[1].has(kLineFeaturesKnown));
+    REQUIRE(features[1].words == compute_line_features("Ende").words);
+}
+
+TEST_CASE("replace_text_macros - Merkmalsvektor anderer Länge wird verworfen") {
+    auto lines = make_lines("Hallo Welt");
+    std::vector<LineFeatures> features = compute_line_features(lines);
+
+    // Text nachträglich um eine Zeile erweitert, Merkmale nicht angepasst
+    lines.push_back({ "Hallo NAME", "test.tex", 2 });
+
+    std::unordered_map<std::string, std::string> defs = {
+        {"NAME", "Max"}
+    };
+    auto result = replace_text_macros(lines, defs, &features);
+
+    REQUIRE(join_lines(result) == "Hallo Welt\nHallo Max\n");
+    REQUIRE(features.size() == result.size());
+}
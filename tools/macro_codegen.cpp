@@ -0,0 +1,55 @@
+/**
+ * macro_codegen.cpp
+ * Build-Werkzeug: erzeugt aus einer Makrodatei (dynamic_macro.json) die
+ * C++-Quelle für builtin_macro_library() (siehe macro_codegen.h).
+ *
+ * Aufruf: macro_codegen <makros.json> <ausgabe.cpp> [herkunft]
+ *
+ * herkunft ersetzt den Pfad der Makrodatei in der erzeugten Quelle
+ * (CMake übergibt ihn relativ zum Quellbaum), sodass die Ausgabe nicht
+ * vom Checkout-Pfad abhängt.
+ *
+ * Die Ausgabedatei wird nur bei geändertem Inhalt neu geschrieben, damit
+ * der Build nicht unnötig neu übersetzt.
+ */
+#include "macro_codegen.h"
+#include "error_collector.h"
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Aufruf: macro_codegen <makros.json> <ausgabe.cpp> [herkunft]\n";
+        return 1;
+    }
+
+    PreprocReport report;
+    MacroTable macros = load_all_macros(argv[1], report);
+    if (report.has_errors()) {
+        for (auto& e : report.errors) {
+            std::cerr << "[Fehler] in " << e.file << ": " << e.message << "\n";
+        }
+        return 1;
+    }
+
+    std::string code = generate_builtin_macros(macros, argc == 4 ? argv[3] : argv[1]);
+
+    std::ifstream existing(argv[2], std::ios::binary);
+    if (existing && std::string(std::istreambuf_iterator<char>(existing), std::istreambuf_iterator<char>()) == code) {
+        return 0;
+    }
+    existing.close();
+
+    std::ofstream out(argv[2], std::ios::binary);
+    out << code;
+    if (!out) {
+        std::cerr << "+++ Fehler: " << argv[2] << " konnte nicht geschrieben werden +++\n";
+        return 1;
+    }
+    return 0;
+}